@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "../src/kded/linklosstracker.h"
+
+#include <QTest>
+#include <QSignalSpy>
+
+static const QString s_ubi = QStringLiteral("/org/bluez/hci0/dev_00_11_22_33_44_55");
+static const QString s_timeout = QStringLiteral("org.bluez.Reason.Timeout");
+
+class LinkLossTrackerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testDisconnectedBeforeConnectedChange();
+    void testDisconnectedAfterConnectedChange();
+    void testOtherReason();
+    void testReconnectedByItself();
+    void testRemoved();
+};
+
+void LinkLossTrackerTest::testDisconnectedBeforeConnectedChange()
+{
+    LinkLossTracker tracker;
+    QSignalSpy spy(&tracker, &LinkLossTracker::linkLost);
+
+    // BlueZ order: Disconnected while Connected is still true
+    tracker.disconnected(s_ubi, s_timeout, true);
+    QCOMPARE(spy.count(), 0);
+
+    tracker.connectedChanged(s_ubi, false);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), s_ubi);
+
+    // Only once per link loss
+    tracker.connectedChanged(s_ubi, false);
+    QCOMPARE(spy.count(), 1);
+}
+
+void LinkLossTrackerTest::testDisconnectedAfterConnectedChange()
+{
+    LinkLossTracker tracker;
+    QSignalSpy spy(&tracker, &LinkLossTracker::linkLost);
+
+    tracker.connectedChanged(s_ubi, false);
+    tracker.disconnected(s_ubi, s_timeout, false);
+    QCOMPARE(spy.count(), 1);
+}
+
+void LinkLossTrackerTest::testOtherReason()
+{
+    LinkLossTracker tracker;
+    QSignalSpy spy(&tracker, &LinkLossTracker::linkLost);
+
+    tracker.disconnected(s_ubi, QStringLiteral("org.bluez.Reason.Remote"), true);
+    tracker.connectedChanged(s_ubi, false);
+    QCOMPARE(spy.count(), 0);
+}
+
+void LinkLossTrackerTest::testReconnectedByItself()
+{
+    LinkLossTracker tracker;
+    QSignalSpy spy(&tracker, &LinkLossTracker::linkLost);
+
+    tracker.disconnected(s_ubi, s_timeout, true);
+    tracker.connectedChanged(s_ubi, true);
+    tracker.connectedChanged(s_ubi, false);
+    QCOMPARE(spy.count(), 0);
+}
+
+void LinkLossTrackerTest::testRemoved()
+{
+    LinkLossTracker tracker;
+    QSignalSpy spy(&tracker, &LinkLossTracker::linkLost);
+
+    tracker.disconnected(s_ubi, s_timeout, true);
+    tracker.remove(s_ubi);
+    tracker.connectedChanged(s_ubi, false);
+    QCOMPARE(spy.count(), 0);
+}
+
+QTEST_GUILESS_MAIN(LinkLossTrackerTest)
+
+#include "linklosstrackertest.moc"
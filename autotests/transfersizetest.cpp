@@ -0,0 +1,157 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "../src/common/transfersize.h"
+#include "../src/common/fileallocation.h"
+
+#include <QTest>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <limits>
+
+static const quint64 MiB = 1024 * 1024;
+static const quint64 GiB = 1024 * MiB;
+
+// Covers the size arithmetic only. No multi-GB transfer is run against a
+// stand-in obexd: TransferFileJob and KioFtp::get() report progress through
+// KIO::SlaveBase, which exits when it has no application connection, so they
+// can't be driven from an in-process test.
+class TransferSizeTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testChunkCount_data();
+    void testChunkCount();
+    void testChunkLength_data();
+    void testChunkLength();
+    void testChunksCoverLargeFile();
+    void testSpeed_data();
+    void testSpeed();
+    void testPreallocateKeepsSize();
+};
+
+void TransferSizeTest::testChunkCount_data()
+{
+    QTest::addColumn<quint64>("size");
+    QTest::addColumn<quint64>("chunkSize");
+    QTest::addColumn<quint64>("count");
+
+    QTest::newRow("empty") << quint64(0) << MiB << quint64(0);
+    QTest::newRow("one byte") << quint64(1) << MiB << quint64(1);
+    QTest::newRow("exact") << 4 * MiB << MiB << quint64(4);
+    QTest::newRow("remainder") << 4 * MiB + 1 << MiB << quint64(5);
+    QTest::newRow("over 4 GiB") << 5 * GiB + 7 << MiB << quint64(5 * 1024 + 1);
+    QTest::newRow("maximum") << std::numeric_limits<quint64>::max() << MiB << std::numeric_limits<quint64>::max() / MiB + 1;
+}
+
+void TransferSizeTest::testChunkCount()
+{
+    QFETCH(quint64, size);
+    QFETCH(quint64, chunkSize);
+    QFETCH(quint64, count);
+
+    QCOMPARE(TransferSize::chunkCount(size, chunkSize), count);
+}
+
+void TransferSizeTest::testChunkLength_data()
+{
+    QTest::addColumn<quint64>("size");
+    QTest::addColumn<quint64>("offset");
+    QTest::addColumn<quint64>("length");
+
+    QTest::newRow("first") << 5 * GiB + 7 << quint64(0) << MiB;
+    QTest::newRow("past 4 GiB") << 5 * GiB + 7 << 4 * GiB + 3 * MiB << MiB;
+    QTest::newRow("last") << 5 * GiB + 7 << 5 * GiB << quint64(7);
+    QTest::newRow("end") << 5 * GiB + 7 << 5 * GiB + 7 << quint64(0);
+    QTest::newRow("after end") << 5 * GiB + 7 << 6 * GiB << quint64(0);
+}
+
+void TransferSizeTest::testChunkLength()
+{
+    QFETCH(quint64, size);
+    QFETCH(quint64, offset);
+    QFETCH(quint64, length);
+
+    QCOMPARE(TransferSize::chunkLength(size, offset, MiB), length);
+}
+
+void TransferSizeTest::testChunksCoverLargeFile()
+{
+    const quint64 size = 6 * GiB + 12345;
+
+    quint64 offset = 0;
+    quint64 chunks = 0;
+    while (offset < size) {
+        const quint64 length = TransferSize::chunkLength(size, offset, MiB);
+        QVERIFY(length > 0);
+        QVERIFY(length <= MiB);
+        offset += length;
+        chunks++;
+    }
+
+    QCOMPARE(offset, size);
+    QCOMPARE(chunks, TransferSize::chunkCount(size, MiB));
+}
+
+void TransferSizeTest::testSpeed_data()
+{
+    QTest::addColumn<quint64>("bytes");
+    QTest::addColumn<qint64>("msecs");
+    QTest::addColumn<quint64>("speed");
+
+    QTest::newRow("no time") << MiB << qint64(0) << quint64(0);
+    QTest::newRow("one second") << MiB << qint64(1000) << MiB;
+    QTest::newRow("fraction") << quint64(1500) << qint64(1000) << quint64(1500);
+    QTest::newRow("slow") << quint64(1) << qint64(3000) << quint64(0);
+    QTest::newRow("5 GiB") << 5 * GiB << qint64(2000) << 5 * GiB / 2;
+    // bytes * 1000 would overflow
+    QTest::newRow("huge") << std::numeric_limits<quint64>::max() / 10 << qint64(1000) << std::numeric_limits<quint64>::max() / 10;
+}
+
+void TransferSizeTest::testSpeed()
+{
+    QFETCH(quint64, bytes);
+    QFETCH(qint64, msecs);
+    QFETCH(quint64, speed);
+
+    QCOMPARE(TransferSize::speed(bytes, msecs), speed);
+}
+
+void TransferSizeTest::testPreallocateKeepsSize()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.close();
+
+    QString errorString;
+    if (!preallocateFile(file.fileName(), 8 * MiB, &errorString)) {
+        QSKIP(qPrintable(QStringLiteral("Preallocation not supported here: %1").arg(errorString)));
+    }
+
+    // Space is reserved, but the file must not grow, obexd appends to it
+    QCOMPARE(QFileInfo(file.fileName()).size(), qint64(0));
+}
+
+QTEST_GUILESS_MAIN(TransferSizeTest)
+
+#include "transfersizetest.moc"
@@ -24,6 +24,7 @@ import org.kde.plasma.plasmoid 2.0
 import org.kde.bluezqt 1.0 as BluezQt
 import org.kde.plasma.core 2.0 as PlasmaCore
 import org.kde.kquickcontrolsaddons 2.0
+import org.kde.plasma.private.bluetooth 1.0 as PlasmaBt
 
 import "logic.js" as Logic
 
@@ -34,6 +35,10 @@ Item {
     property int runningActions : 0
     property QtObject btManager : BluezQt.Manager
 
+    PlasmaBt.DevicesChangedWatcher {
+        id: devicesWatcher
+    }
+
     Plasmoid.toolTipMainText: i18n("Bluetooth")
     Plasmoid.icon: Logic.icon()
 
@@ -80,7 +80,7 @@ PlasmaExtras.ExpandableListItem {
                     id: browseFilesButton
                     text: i18n("Browse Files")
                     iconSource: "folder"
-                    visible: Uuids.indexOf(BluezQt.Services.ObexFileTransfer) != -1
+                    visible: (Services & PlasmaBt.Services.ObexFileTransfer) != 0
 
                     onClicked: {
                         var url = "obexftp://%1/".arg(Address.replace(/:/g, "-"));
@@ -92,7 +92,7 @@ PlasmaExtras.ExpandableListItem {
                     id: sendFileButton
                     text: i18n("Send File")
                     iconSource: "folder-download"
-                    visible: Uuids.indexOf(BluezQt.Services.ObexObjectPush) != -1
+                    visible: (Services & PlasmaBt.Services.ObexObjectPush) != 0
 
                     onClicked: {
                         PlasmaBt.LaunchApp.runCommand("bluedevil-sendfile", ["-u", Ubi]);
@@ -276,19 +276,19 @@ PlasmaExtras.ExpandableListItem {
         default:
             var profiles = [];
 
-            if (Uuids.indexOf(BluezQt.Services.ObexFileTransfer) != -1) {
+            if (Services & PlasmaBt.Services.ObexFileTransfer) {
                 profiles.push(i18n("File transfer"));
             }
-            if (Uuids.indexOf(BluezQt.Services.ObexObjectPush) != -1) {
+            if (Services & PlasmaBt.Services.ObexObjectPush) {
                 profiles.push(i18n("Send file"));
             }
-            if (Uuids.indexOf(BluezQt.Services.HumanInterfaceDevice) != -1) {
+            if (Services & PlasmaBt.Services.HumanInterfaceDevice) {
                 profiles.push(i18n("Input"));
             }
-            if (Uuids.indexOf(BluezQt.Services.AdvancedAudioDistribution) != -1) {
+            if (Services & PlasmaBt.Services.AdvancedAudioDistribution) {
                 profiles.push(i18n("Audio"));
             }
-            if (Uuids.indexOf(BluezQt.Services.Nap) != -1) {
+            if (Services & PlasmaBt.Services.Nap) {
                 profiles.push(i18n("Network"));
             }
 
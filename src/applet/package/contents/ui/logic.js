@@ -22,7 +22,13 @@ function init()
 {
     btManager.deviceAdded.connect(updateStatus);
     btManager.deviceRemoved.connect(updateStatus);
-    btManager.deviceChanged.connect(updateStatus);
+    // Batched changes from kded, raw device changes only when kded is not running
+    devicesWatcher.devicesChanged.connect(updateStatus);
+    btManager.deviceChanged.connect(function() {
+        if (!devicesWatcher.available) {
+            updateStatus();
+        }
+    });
     btManager.bluetoothBlockedChanged.connect(updateStatus);
     btManager.bluetoothOperationalChanged.connect(updateStatus);
 
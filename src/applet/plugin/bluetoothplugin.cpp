@@ -22,6 +22,8 @@
 #include "devicesproxymodel.h"
 #include "launchapp.h"
 #include "notify.h"
+#include "../../common/deviceschangedwatcher.h"
+#include "../../common/bluetoothservices.h"
 
 #include <QQmlEngine>
 
@@ -48,4 +50,6 @@ void BluetoothPlugin::registerTypes(const char *uri)
     qmlRegisterSingletonType<Notify>(uri, 1, 0, "Notify", notify_singleton);
     qmlRegisterSingletonType<LaunchApp>(uri, 1, 0, "LaunchApp", launchapp_singleton);
     qmlRegisterType<DevicesProxyModel>(uri, 1, 0, "DevicesProxyModel");
+    qmlRegisterType<DevicesChangedWatcher>(uri, 1, 0, "DevicesChangedWatcher");
+    qmlRegisterUncreatableMetaObject(BluetoothServices::staticMetaObject, uri, 1, 0, "Services", QStringLiteral("Services only contains enums"));
 }
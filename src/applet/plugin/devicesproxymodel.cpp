@@ -19,22 +19,38 @@
 */
 
 #include "devicesproxymodel.h"
+#include "../../common/deviceschangedwatcher.h"
+#include "../../common/deviceservicescache.h"
 
 #include <BluezQt/Adapter>
 #include <BluezQt/Device>
 
 DevicesProxyModel::DevicesProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
+    , m_watcher(new DevicesChangedWatcher(this))
+    , m_servicesCache(new DeviceServicesCache(this))
 {
-    setDynamicSortFilter(true);
+    // Resorting on every property change (eg. RSSI during discovery) is expensive,
+    // so sort again only on the batched changes from kded when it's running
+    connect(m_watcher, &DevicesChangedWatcher::devicesChanged, this, &DevicesProxyModel::invalidate);
+    connect(m_watcher, &DevicesChangedWatcher::availableChanged, this, &DevicesProxyModel::updateDynamicSortFilter);
+
+    updateDynamicSortFilter();
     sort(0, Qt::DescendingOrder);
 }
 
+void DevicesProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    m_servicesCache->setModel(sourceModel);
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
 QHash<int, QByteArray> DevicesProxyModel::roleNames() const
 {
     QHash<int, QByteArray> roles = QSortFilterProxyModel::roleNames();
     roles[SectionRole] = QByteArrayLiteral("Section");
     roles[DeviceFullNameRole] = QByteArrayLiteral("DeviceFullName");
+    roles[ServicesRole] = QByteArrayLiteral("Services");
     return roles;
 }
 
@@ -59,6 +75,9 @@ QVariant DevicesProxyModel::data(const QModelIndex &index, int role) const
         }
         return QSortFilterProxyModel::data(index, BluezQt::DevicesModel::NameRole);
 
+    case ServicesRole:
+        return static_cast<uint>(m_servicesCache->services(mapToSource(index)));
+
     default:
         return QSortFilterProxyModel::data(index, role);
     }
@@ -98,6 +117,11 @@ QString DevicesProxyModel::adapterHciString(const QString &ubi) const
     return ubi.mid(startIndex, endIndex - startIndex);
 }
 
+void DevicesProxyModel::updateDynamicSortFilter()
+{
+    setDynamicSortFilter(!m_watcher->isAvailable());
+}
+
 bool DevicesProxyModel::duplicateIndexAddress(const QModelIndex &idx) const
 {
     const QModelIndexList &list = match(index(0, 0),
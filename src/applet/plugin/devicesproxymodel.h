@@ -24,6 +24,9 @@
 #include <BluezQt/DevicesModel>
 #include <QSortFilterProxyModel>
 
+class DevicesChangedWatcher;
+class DeviceServicesCache;
+
 class DevicesProxyModel : public QSortFilterProxyModel
 {
     Q_OBJECT
@@ -32,10 +35,12 @@ public:
     enum AdditionalRoles {
         SectionRole = BluezQt::DevicesModel::LastRole + 10,
         DeviceFullNameRole = BluezQt::DevicesModel::LastRole + 11,
+        ServicesRole = BluezQt::DevicesModel::LastRole + 12,
     };
 
     explicit DevicesProxyModel(QObject *parent = nullptr);
 
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
     QHash<int, QByteArray> roleNames() const override;
     QVariant data(const QModelIndex &index, int role) const override;
     bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
@@ -44,6 +49,10 @@ public:
 
 private:
     bool duplicateIndexAddress(const QModelIndex &idx) const;
+    void updateDynamicSortFilter();
+
+    DevicesChangedWatcher *m_watcher;
+    DeviceServicesCache *m_servicesCache;
 };
 
 #endif // DEVICESPROXYMODEL_H
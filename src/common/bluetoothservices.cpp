@@ -0,0 +1,132 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "bluetoothservices.h"
+
+#include <QtAlgorithms>
+
+namespace BluetoothServices
+{
+
+struct ServiceEntry
+{
+    // First 32 bits of the UUID
+    quint32 shortId;
+    const char *uuid;
+    Service service;
+};
+
+// Ordered by the bit of the service
+static constexpr ServiceEntry s_table[] = {
+    { 0x1105, "00001105-0000-1000-8000-00805F9B34FB", ObexObjectPush },
+    { 0x1106, "00001106-0000-1000-8000-00805F9B34FB", ObexFileTransfer },
+    { 0x5005, "00005005-0000-1000-8000-0002EE000001", PcSuite },
+    { 0x110B, "0000110B-0000-1000-8000-00805F9B34FB", AudioSink },
+    { 0x110A, "0000110A-0000-1000-8000-00805F9B34FB", AudioSource },
+    { 0x1108, "00001108-0000-1000-8000-00805F9B34FB", Headset },
+    { 0x111E, "0000111E-0000-1000-8000-00805F9B34FB", Handsfree },
+    { 0x1116, "00001116-0000-1000-8000-00805F9B34FB", Nap },
+    { 0x1103, "00001103-0000-1000-8000-00805F9B34FB", DialupNetworking },
+    { 0x1124, "00001124-0000-1000-8000-00805F9B34FB", HumanInterfaceDevice },
+    { 0x110D, "0000110D-0000-1000-8000-00805F9B34FB", AdvancedAudioDistribution },
+};
+
+static constexpr int s_tableSize = sizeof(s_table) / sizeof(s_table[0]);
+
+// shortId % s_hashSize is a perfect hash of the table
+static constexpr quint32 s_hashSize = 29;
+
+// Index into s_table for every hash, -1 for unused hashes
+static constexpr qint8 s_slots[s_hashSize] = {
+    -1, -1, -1,  6, -1,  8, -1,  0,  1,  9,
+     5,  2,  4,  3, -1, 10, -1, -1, -1, -1,
+    -1, -1, -1, -1,  7, -1, -1, -1, -1
+};
+
+static constexpr bool isValidTable(int i = 0)
+{
+    return i == s_tableSize
+        || (s_table[i].service == 1 << i
+            && s_slots[s_table[i].shortId % s_hashSize] == i
+            && isValidTable(i + 1));
+}
+
+static_assert(isValidTable(), "s_slots must match s_table and s_table must be ordered by bits");
+
+Services fromUuid(const QString &uuid)
+{
+    if (uuid.size() != 36) {
+        return Services();
+    }
+
+    bool ok;
+    const quint32 shortId = uuid.leftRef(8).toUInt(&ok, 16);
+    if (!ok) {
+        return Services();
+    }
+
+    const int index = s_slots[shortId % s_hashSize];
+    if (index < 0 || s_table[index].shortId != shortId) {
+        return Services();
+    }
+
+    if (uuid.compare(QLatin1String(s_table[index].uuid), Qt::CaseInsensitive) != 0) {
+        return Services();
+    }
+
+    return s_table[index].service;
+}
+
+Services fromUuids(const QStringList &uuids)
+{
+    Services services;
+
+    Q_FOREACH (const QString &uuid, uuids) {
+        services |= fromUuid(uuid);
+    }
+
+    return services;
+}
+
+QString uuid(Service service)
+{
+    const int index = qCountTrailingZeroBits(static_cast<quint32>(service));
+    if (index >= s_tableSize || service != 1 << index) {
+        return QString();
+    }
+
+    return QLatin1String(s_table[index].uuid);
+}
+
+QStringList uuids(Services services)
+{
+    QStringList uuids;
+
+    for (int i = 0; i < s_tableSize; ++i) {
+        if (services & s_table[i].service) {
+            uuids.append(QLatin1String(s_table[i].uuid));
+        }
+    }
+
+    return uuids;
+}
+
+}
@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef BLUETOOTHSERVICES_H
+#define BLUETOOTHSERVICES_H
+
+#include <QFlags>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Bluetooth services known to BlueDevil.
+ *
+ * Service UUIDs are mapped once to a compact bitmask, which is cheap to store,
+ * to send over D-Bus (as uint) and to filter on.
+ */
+namespace BluetoothServices
+{
+Q_NAMESPACE
+
+// Bit i is the service at index i of the table in bluetoothservices.cpp
+enum Service {
+    ObexObjectPush = 1 << 0,
+    ObexFileTransfer = 1 << 1,
+    PcSuite = 1 << 2,
+    AudioSink = 1 << 3,
+    AudioSource = 1 << 4,
+    Headset = 1 << 5,
+    Handsfree = 1 << 6,
+    Nap = 1 << 7,
+    DialupNetworking = 1 << 8,
+    HumanInterfaceDevice = 1 << 9,
+    AdvancedAudioDistribution = 1 << 10,
+
+    ObexServices = ObexObjectPush | ObexFileTransfer,
+    AudioServices = AudioSink | Headset | Handsfree
+};
+Q_ENUM_NS(Service)
+Q_DECLARE_FLAGS(Services, Service)
+
+// Returns the service of uuid (in any case), or no service for unknown uuids
+Services fromUuid(const QString &uuid);
+Services fromUuids(const QStringList &uuids);
+
+// Returns the uppercase UUIDs of services
+QString uuid(Service service);
+QStringList uuids(Services services);
+
+}
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(BluetoothServices::Services)
+
+#endif // BLUETOOTHSERVICES_H
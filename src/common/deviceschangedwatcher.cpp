@@ -0,0 +1,135 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "deviceschangedwatcher.h"
+
+#include <QDBusMessage>
+#include <QDBusConnection>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QDBusPendingCallWatcher>
+
+#include <BluezQt/Manager>
+
+static const QString s_kdedService = QStringLiteral("org.kde.kded5");
+static const QString s_kdedPath = QStringLiteral("/kded");
+static const QString s_moduleName = QStringLiteral("bluedevil");
+
+// Same rate as the devicesChanged signal of kded
+static const int s_fallbackInterval = 250;
+
+DevicesChangedWatcher::DevicesChangedWatcher(QObject *parent)
+    : DevicesChangedWatcher(nullptr, parent)
+{
+}
+
+DevicesChangedWatcher::DevicesChangedWatcher(BluezQt::Manager *manager, QObject *parent)
+    : QObject(parent)
+    , m_available(false)
+{
+    QDBusConnection::sessionBus().connect(s_kdedService, QStringLiteral("/modules/bluedevil"),
+                                          QStringLiteral("org.kde.BlueDevil"), QStringLiteral("devicesChanged"),
+                                          this, SLOT(kdedDevicesChanged(quint64)));
+
+    // kded itself may be running without the bluedevil module
+    QDBusConnection::sessionBus().connect(s_kdedService, s_kdedPath, s_kdedService, QStringLiteral("moduleLoaded"),
+                                          this, SLOT(moduleLoaded(QString)));
+    QDBusConnection::sessionBus().connect(s_kdedService, s_kdedPath, s_kdedService, QStringLiteral("moduleUnloaded"),
+                                          this, SLOT(moduleUnloaded(QString)));
+
+    m_serviceWatcher = new QDBusServiceWatcher(s_kdedService, QDBusConnection::sessionBus(),
+                                               QDBusServiceWatcher::WatchForOwnerChange, this);
+
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceRegistered, this, &DevicesChangedWatcher::queryLoadedModules);
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, this, [this]() {
+        setAvailable(false);
+    });
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(s_fallbackInterval);
+    connect(&m_timer, &QTimer::timeout, this, &DevicesChangedWatcher::devicesChanged);
+
+    if (manager) {
+        connect(manager, &BluezQt::Manager::deviceChanged, this, &DevicesChangedWatcher::deviceChanged);
+    }
+
+    queryLoadedModules();
+}
+
+bool DevicesChangedWatcher::isAvailable() const
+{
+    return m_available;
+}
+
+void DevicesChangedWatcher::kdedDevicesChanged(quint64 generation)
+{
+    Q_UNUSED(generation)
+
+    Q_EMIT devicesChanged();
+}
+
+void DevicesChangedWatcher::queryLoadedModules()
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(s_kdedService, s_kdedPath, s_kdedService,
+                                                       QStringLiteral("loadedModules"));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, &DevicesChangedWatcher::loadedModulesFinished);
+}
+
+void DevicesChangedWatcher::loadedModulesFinished(QDBusPendingCallWatcher *watcher)
+{
+    const QDBusPendingReply<QStringList> &reply = *watcher;
+    watcher->deleteLater();
+
+    setAvailable(!reply.isError() && reply.value().contains(s_moduleName));
+}
+
+void DevicesChangedWatcher::moduleLoaded(const QString &module)
+{
+    if (module == s_moduleName) {
+        setAvailable(true);
+    }
+}
+
+void DevicesChangedWatcher::moduleUnloaded(const QString &module)
+{
+    if (module == s_moduleName) {
+        setAvailable(false);
+    }
+}
+
+void DevicesChangedWatcher::deviceChanged()
+{
+    if (!m_available && !m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void DevicesChangedWatcher::setAvailable(bool available)
+{
+    if (m_available == available) {
+        return;
+    }
+
+    m_available = available;
+    Q_EMIT availableChanged(m_available);
+}
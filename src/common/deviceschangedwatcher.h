@@ -0,0 +1,73 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef DEVICESCHANGEDWATCHER_H
+#define DEVICESCHANGEDWATCHER_H
+
+#include <QTimer>
+#include <QObject>
+
+#include <BluezQt/Types>
+
+class QDBusServiceWatcher;
+class QDBusPendingCallWatcher;
+
+/**
+ * Notifies about device changes that matter to the UI.
+ *
+ * Follows the devicesChanged signal of the BlueDevil kded module, which
+ * batches property changes, rounds RSSI and drops changes that don't affect
+ * the name, icon, UUIDs, connected or paired state. When the module is not
+ * loaded in kded and a manager is set, deviceChanged of the manager is used
+ * instead, limited to the same rate.
+ */
+class DevicesChangedWatcher : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool available READ isAvailable NOTIFY availableChanged)
+
+public:
+    explicit DevicesChangedWatcher(QObject *parent = nullptr);
+    explicit DevicesChangedWatcher(BluezQt::Manager *manager, QObject *parent = nullptr);
+
+    // Whether the bluedevil module is loaded in kded and provides the changes
+    bool isAvailable() const;
+
+Q_SIGNALS:
+    void devicesChanged();
+    void availableChanged(bool available);
+
+private Q_SLOTS:
+    void kdedDevicesChanged(quint64 generation);
+    void queryLoadedModules();
+    void loadedModulesFinished(QDBusPendingCallWatcher *watcher);
+    void moduleLoaded(const QString &module);
+    void moduleUnloaded(const QString &module);
+    void deviceChanged();
+    void setAvailable(bool available);
+
+private:
+    QDBusServiceWatcher *m_serviceWatcher;
+    QTimer m_timer;
+    bool m_available;
+};
+
+#endif // DEVICESCHANGEDWATCHER_H
@@ -0,0 +1,93 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "deviceservicescache.h"
+
+#include <QAbstractItemModel>
+
+#include <BluezQt/DevicesModel>
+
+DeviceServicesCache::DeviceServicesCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void DeviceServicesCache::setModel(QAbstractItemModel *model)
+{
+    if (m_model == model) {
+        return;
+    }
+
+    if (m_model) {
+        m_model->disconnect(this);
+    }
+
+    m_model = model;
+    m_services.clear();
+
+    if (!m_model) {
+        return;
+    }
+
+    connect(m_model, &QAbstractItemModel::dataChanged, this, &DeviceServicesCache::dataChanged);
+    connect(m_model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &DeviceServicesCache::rowsAboutToBeRemoved);
+    connect(m_model, &QAbstractItemModel::modelReset, this, &DeviceServicesCache::clear);
+}
+
+BluetoothServices::Services DeviceServicesCache::services(const QModelIndex &index) const
+{
+    const QString &ubi = index.data(BluezQt::DevicesModel::UbiRole).toString();
+
+    auto it = m_services.constFind(ubi);
+    if (it != m_services.constEnd()) {
+        return it.value();
+    }
+
+    const QStringList &uuids = index.data(BluezQt::DevicesModel::UuidsRole).toStringList();
+    const BluetoothServices::Services services = BluetoothServices::fromUuids(uuids);
+    m_services.insert(ubi, services);
+    return services;
+}
+
+void DeviceServicesCache::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    // DevicesModel doesn't tell which roles changed
+    removeRows(topLeft.row(), bottomRight.row());
+}
+
+void DeviceServicesCache::rowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent)
+
+    removeRows(first, last);
+}
+
+void DeviceServicesCache::clear()
+{
+    m_services.clear();
+}
+
+void DeviceServicesCache::removeRows(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        m_services.remove(m_model->index(row, 0).data(BluezQt::DevicesModel::UbiRole).toString());
+    }
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef DEVICESERVICESCACHE_H
+#define DEVICESERVICESCACHE_H
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QModelIndex>
+
+#include "bluetoothservices.h"
+
+class QAbstractItemModel;
+
+/**
+ * Services of the devices in a BluezQt::DevicesModel.
+ *
+ * The bitmask of a device is computed from its UUIDs on first use and kept
+ * until the model reports a change of the device, so that models filtering
+ * or sorting on services don't map the UUIDs on every call.
+ */
+class DeviceServicesCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DeviceServicesCache(QObject *parent = nullptr);
+
+    // Set before other users of the model connect to it, so that the cache
+    // drops changed devices before they ask for the services again
+    void setModel(QAbstractItemModel *model);
+
+    // Services of the device at index of the model
+    BluetoothServices::Services services(const QModelIndex &index) const;
+
+private Q_SLOTS:
+    void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void rowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void clear();
+
+private:
+    void removeRows(int first, int last);
+
+    QPointer<QAbstractItemModel> m_model;
+    // By ubi
+    mutable QHash<QString, BluetoothServices::Services> m_services;
+};
+
+#endif // DEVICESERVICESCACHE_H
@@ -0,0 +1,113 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "discoveryfilter.h"
+
+#include <QSet>
+#include <QStringList>
+#include <QDBusMessage>
+#include <QDBusConnection>
+
+static const QString s_transport = QStringLiteral("Transport");
+static const QString s_rssi = QStringLiteral("RSSI");
+static const QString s_pathloss = QStringLiteral("Pathloss");
+static const QString s_uuids = QStringLiteral("UUIDs");
+static const QString s_duplicateData = QStringLiteral("DuplicateData");
+
+QVariantMap DiscoveryFilter::merge(const QList<QVariantMap> &filters)
+{
+    QVariantMap merged;
+
+    if (filters.isEmpty()) {
+        return merged;
+    }
+
+    // A key can only be kept when every filter restricts it
+    bool hasRssi = true;
+    bool hasPathloss = true;
+    bool hasUuids = true;
+    bool duplicateData = false;
+    QString transport = filters.first().value(s_transport, QStringLiteral("auto")).toString();
+    qint16 rssi = 0;
+    quint16 pathloss = 0;
+    QSet<QString> uuids;
+
+    Q_FOREACH (const QVariantMap &filter, filters) {
+        if (filter.value(s_transport, QStringLiteral("auto")).toString() != transport) {
+            transport = QStringLiteral("auto");
+        }
+
+        if (filter.contains(s_rssi)) {
+            const qint16 value = filter.value(s_rssi).value<qint16>();
+            rssi = rssi == 0 ? value : qMin(rssi, value);
+        } else {
+            hasRssi = false;
+        }
+
+        if (filter.contains(s_pathloss)) {
+            pathloss = qMax(pathloss, filter.value(s_pathloss).value<quint16>());
+        } else {
+            hasPathloss = false;
+        }
+
+        const QStringList filterUuids = filter.value(s_uuids).toStringList();
+        if (filterUuids.isEmpty()) {
+            hasUuids = false;
+        } else {
+            uuids.unite(QSet<QString>(filterUuids.constBegin(), filterUuids.constEnd()));
+        }
+
+        // BlueZ reports duplicates unless asked not to
+        duplicateData |= filter.value(s_duplicateData, true).toBool();
+    }
+
+    if (transport != QLatin1String("auto")) {
+        merged.insert(s_transport, transport);
+    }
+
+    // BlueZ doesn't allow RSSI and Pathloss together, prefer RSSI
+    if (hasRssi) {
+        merged.insert(s_rssi, QVariant::fromValue(rssi));
+    } else if (hasPathloss) {
+        merged.insert(s_pathloss, QVariant::fromValue(pathloss));
+    }
+
+    if (hasUuids) {
+        merged.insert(s_uuids, QStringList(uuids.values()));
+    }
+
+    if (!duplicateData) {
+        merged.insert(s_duplicateData, false);
+    }
+
+    return merged;
+}
+
+QDBusPendingCall DiscoveryFilter::apply(const QString &adapterUbi, const QVariantMap &filter)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(QStringLiteral("org.bluez"),
+                            adapterUbi,
+                            QStringLiteral("org.bluez.Adapter1"),
+                            QStringLiteral("SetDiscoveryFilter"));
+    call << filter;
+
+    return QDBusConnection::systemBus().asyncCall(call);
+}
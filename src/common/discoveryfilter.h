@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef DISCOVERYFILTER_H
+#define DISCOVERYFILTER_H
+
+#include <QList>
+#include <QVariantMap>
+#include <QDBusPendingCall>
+
+/**
+ * Helpers for BlueZ discovery filters (org.bluez.Adapter1.SetDiscoveryFilter).
+ *
+ * A filter is a map with the keys BlueZ understands: "Transport" ("auto",
+ * "bredr" or "le"), "RSSI", "Pathloss", "UUIDs" and "DuplicateData".
+ * An empty map means unfiltered discovery.
+ */
+namespace DiscoveryFilter
+{
+
+/**
+ * Returns a filter that finds every device any of @p filters finds.
+ */
+QVariantMap merge(const QList<QVariantMap> &filters);
+
+/**
+ * Sets @p filter for discoveries started by this process on the adapter
+ * with @p adapterUbi object path.
+ */
+QDBusPendingCall apply(const QString &adapterUbi, const QVariantMap &filter);
+
+}
+
+#endif // DISCOVERYFILTER_H
@@ -0,0 +1,41 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef FILEALLOCATION_H
+#define FILEALLOCATION_H
+
+#include <QtGlobal>
+
+class QString;
+
+/**
+ * Reserves disk space for the whole file without changing its size, so that
+ * large files don't get fragmented while they are written in small chunks.
+ *
+ * obexd truncates files when opening them, so this has to be called once
+ * the transfer is active.
+ *
+ * Returns false when the space could not be reserved, in which case
+ * @p errorString is set to the reason.
+ */
+bool preallocateFile(const QString &filePath, quint64 size, QString *errorString = nullptr);
+
+#endif // FILEALLOCATION_H
@@ -0,0 +1,256 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "transferhistory.h"
+
+#include <QDir>
+#include <QLoggingCategory>
+#include <QLocale>
+#include <QVariant>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlDatabase>
+#include <QStandardPaths>
+
+Q_LOGGING_CATEGORY(HISTORY, "bluedevil.history")
+
+static const int s_schemaVersion = 2;
+
+quint64 TransferHistory::Entry::throughput() const
+{
+    return duration > 0 ? size * 1000 / duration : 0;
+}
+
+TransferHistory::TransferHistory(const QString &connectionName)
+    : m_connectionName(connectionName)
+    , m_valid(false)
+{
+    m_valid = open();
+}
+
+TransferHistory::~TransferHistory()
+{
+    QSqlDatabase::database(m_connectionName, false).close();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool TransferHistory::isValid() const
+{
+    return m_valid;
+}
+
+bool TransferHistory::open()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/bluedevil");
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionName);
+    db.setDatabaseName(dir + QStringLiteral("/history.sqlite"));
+    db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=5000"));
+
+    if (!db.open()) {
+        qCWarning(HISTORY) << "Error opening transfer history" << db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+
+    // Readers (kio_bluetooth) don't block the writers
+    query.exec(QStringLiteral("PRAGMA journal_mode=WAL"));
+
+    query.exec(QStringLiteral("PRAGMA user_version"));
+    if (query.next() && query.value(0).toInt() == s_schemaVersion) {
+        return true;
+    }
+
+    // The devices and days tables summarize the transfers, so listing them
+    // doesn't scan the whole history. Triggers keep them up to date for all
+    // writers. Version 1 databases get them filled once from the transfers.
+    const QStringList statements = {
+        QStringLiteral("CREATE TABLE IF NOT EXISTS transfers ("
+                       "id INTEGER PRIMARY KEY,"
+                       "direction INTEGER NOT NULL,"
+                       "address TEXT NOT NULL,"
+                       "device TEXT,"
+                       "file TEXT NOT NULL,"
+                       "url TEXT,"
+                       "size INTEGER NOT NULL,"
+                       "time INTEGER NOT NULL,"
+                       "day INTEGER NOT NULL,"
+                       "duration INTEGER NOT NULL,"
+                       "success INTEGER NOT NULL,"
+                       "error TEXT)"),
+        QStringLiteral("CREATE INDEX IF NOT EXISTS transfers_address ON transfers (address, time)"),
+        QStringLiteral("CREATE INDEX IF NOT EXISTS transfers_day ON transfers (day, time)"),
+        QStringLiteral("CREATE TABLE IF NOT EXISTS devices ("
+                       "address TEXT PRIMARY KEY,"
+                       "device TEXT,"
+                       "count INTEGER NOT NULL,"
+                       "last INTEGER NOT NULL)"),
+        QStringLiteral("CREATE INDEX IF NOT EXISTS devices_last ON devices (last)"),
+        QStringLiteral("CREATE TABLE IF NOT EXISTS days ("
+                       "day INTEGER PRIMARY KEY,"
+                       "count INTEGER NOT NULL)"),
+        QStringLiteral("CREATE TRIGGER IF NOT EXISTS transfers_summary AFTER INSERT ON transfers BEGIN "
+                       "INSERT OR IGNORE INTO devices (address, device, count, last) VALUES (NEW.address, NEW.device, 0, NEW.time);"
+                       "UPDATE devices SET device = NEW.device, count = count + 1, last = MAX(last, NEW.time) WHERE address = NEW.address;"
+                       "INSERT OR IGNORE INTO days (day, count) VALUES (NEW.day, 0);"
+                       "UPDATE days SET count = count + 1 WHERE day = NEW.day;"
+                       "END"),
+        QStringLiteral("DELETE FROM devices"),
+        QStringLiteral("INSERT INTO devices (address, device, count, last) "
+                       "SELECT address, device, COUNT(*), MAX(time) FROM transfers GROUP BY address"),
+        QStringLiteral("DELETE FROM days"),
+        QStringLiteral("INSERT INTO days (day, count) SELECT day, COUNT(*) FROM transfers GROUP BY day"),
+        QStringLiteral("PRAGMA user_version = %1").arg(s_schemaVersion)
+    };
+
+    // Another process may be upgrading at the same time
+    db.transaction();
+
+    Q_FOREACH (const QString &statement, statements) {
+        if (!query.exec(statement)) {
+            qCWarning(HISTORY) << "Error creating transfer history" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+
+    return db.commit();
+}
+
+void TransferHistory::add(const Entry &entry)
+{
+    if (!m_valid) {
+        return;
+    }
+
+    QSqlQuery query(QSqlDatabase::database(m_connectionName));
+    query.prepare(QStringLiteral("INSERT INTO transfers (direction, address, device, file, url, size, time, day, duration, success, error) "
+                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"));
+    query.addBindValue(int(entry.direction));
+    query.addBindValue(entry.address);
+    query.addBindValue(entry.deviceName);
+    query.addBindValue(entry.fileName);
+    query.addBindValue(entry.url.toString());
+    query.addBindValue(qint64(entry.size));
+    query.addBindValue(entry.time.toMSecsSinceEpoch());
+    query.addBindValue(entry.time.date().toJulianDay());
+    query.addBindValue(entry.duration);
+    query.addBindValue(entry.success ? 1 : 0);
+    query.addBindValue(entry.errorText);
+
+    if (!query.exec()) {
+        qCWarning(HISTORY) << "Error adding transfer to history" << query.lastError().text();
+    }
+}
+
+QList<TransferHistory::Group> TransferHistory::devices() const
+{
+    QList<Group> groups;
+
+    if (!m_valid) {
+        return groups;
+    }
+
+    QSqlQuery query(QSqlDatabase::database(m_connectionName));
+    query.exec(QStringLiteral("SELECT address, device, count FROM devices ORDER BY last DESC"));
+
+    while (query.next()) {
+        Group group;
+        group.key = query.value(0).toString();
+        group.name = query.value(1).toString();
+        group.count = query.value(2).toInt();
+        groups.append(group);
+    }
+
+    return groups;
+}
+
+QList<TransferHistory::Group> TransferHistory::days() const
+{
+    QList<Group> groups;
+
+    if (!m_valid) {
+        return groups;
+    }
+
+    QSqlQuery query(QSqlDatabase::database(m_connectionName));
+    query.exec(QStringLiteral("SELECT day, count FROM days ORDER BY day DESC"));
+
+    while (query.next()) {
+        const QDate day = QDate::fromJulianDay(query.value(0).toLongLong());
+
+        Group group;
+        group.key = day.toString(Qt::ISODate);
+        group.name = QLocale().toString(day, QLocale::LongFormat);
+        group.count = query.value(1).toInt();
+        groups.append(group);
+    }
+
+    return groups;
+}
+
+QList<TransferHistory::Entry> TransferHistory::entriesForDevice(const QString &address) const
+{
+    return entries(QStringLiteral("address = ?"), address);
+}
+
+QList<TransferHistory::Entry> TransferHistory::entriesForDay(const QDate &day) const
+{
+    return entries(QStringLiteral("day = ?"), day.toJulianDay());
+}
+
+QList<TransferHistory::Entry> TransferHistory::entries(const QString &where, const QVariant &value) const
+{
+    QList<Entry> list;
+
+    if (!m_valid) {
+        return list;
+    }
+
+    QSqlQuery query(QSqlDatabase::database(m_connectionName));
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT id, direction, address, device, file, url, size, time, duration, success, error "
+                                 "FROM transfers WHERE %1 ORDER BY time DESC").arg(where));
+    query.addBindValue(value);
+    query.exec();
+
+    while (query.next()) {
+        Entry entry;
+        entry.id = query.value(0).toLongLong();
+        entry.direction = static_cast<Direction>(query.value(1).toInt());
+        entry.address = query.value(2).toString();
+        entry.deviceName = query.value(3).toString();
+        entry.fileName = query.value(4).toString();
+        entry.url = QUrl(query.value(5).toString());
+        entry.size = query.value(6).toULongLong();
+        entry.time = QDateTime::fromMSecsSinceEpoch(query.value(7).toLongLong());
+        entry.duration = query.value(8).toLongLong();
+        entry.success = query.value(9).toBool();
+        entry.errorText = query.value(10).toString();
+        list.append(entry);
+    }
+
+    return list;
+}
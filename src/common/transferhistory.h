@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef TRANSFERHISTORY_H
+#define TRANSFERHISTORY_H
+
+#include <QUrl>
+#include <QDate>
+#include <QList>
+#include <QString>
+#include <QDateTime>
+
+/**
+ * Database of sent and received files.
+ *
+ * Transfers are stored in an SQLite database shared by kded, bluedevil-sendfile
+ * and kio_bluetooth. It is indexed by device and by day, and keeps a summary
+ * row per device and per day, so the views in kio_bluetooth stay fast with
+ * a long history.
+ */
+class TransferHistory
+{
+public:
+    enum Direction {
+        Sent = 0,
+        Received = 1
+    };
+
+    struct Entry
+    {
+        qint64 id = 0;
+        Direction direction = Received;
+        QString address;
+        QString deviceName;
+        QString fileName;
+        QUrl url;
+        quint64 size = 0;
+        QDateTime time;
+        qint64 duration = 0; // msec
+        bool success = false;
+        QString errorText;
+
+        // Bytes per second
+        quint64 throughput() const;
+    };
+
+    struct Group
+    {
+        QString key;
+        QString name;
+        int count = 0;
+    };
+
+    explicit TransferHistory(const QString &connectionName);
+    ~TransferHistory();
+
+    bool isValid() const;
+
+    void add(const Entry &entry);
+
+    // Devices with their address as key, sorted by most recent transfer
+    QList<Group> devices() const;
+
+    // Days in ISO format as key, newest first
+    QList<Group> days() const;
+
+    QList<Entry> entriesForDevice(const QString &address) const;
+    QList<Entry> entriesForDay(const QDate &day) const;
+
+private:
+    bool open();
+    QList<Entry> entries(const QString &where, const QVariant &value) const;
+
+    QString m_connectionName;
+    bool m_valid;
+};
+
+#endif // TRANSFERHISTORY_H
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef TRANSFERSIZE_H
+#define TRANSFERSIZE_H
+
+#include <QtGlobal>
+
+/**
+ * Size arithmetic for transfers, safe for files larger than 4 GiB.
+ */
+namespace TransferSize
+{
+
+// Bytes per second for bytes transferred in msecs, without overflowing for large byte counts
+inline quint64 speed(quint64 bytes, qint64 msecs)
+{
+    if (msecs <= 0) {
+        return 0;
+    }
+
+    const quint64 ms = quint64(msecs);
+    return bytes / ms * 1000 + bytes % ms * 1000 / ms;
+}
+
+// Number of chunks of chunkSize bytes needed for size bytes
+inline quint64 chunkCount(quint64 size, quint64 chunkSize)
+{
+    return size / chunkSize + (size % chunkSize ? 1 : 0);
+}
+
+// Length of the chunk starting at offset, 0 when offset is at or after the end
+inline quint64 chunkLength(quint64 size, quint64 offset, quint64 chunkSize)
+{
+    return offset >= size ? 0 : qMin(chunkSize, size - offset);
+}
+
+}
+
+#endif // TRANSFERSIZE_H
@@ -22,11 +22,74 @@
 #ifndef KDED_BLUEDEVIL_TYPES_H
 #define KDED_BLUEDEVIL_TYPES_H
 
+#include <QList>
 #include <QMetaType>
+#include <QStringList>
+#include <QDBusArgument>
 
 typedef QMap<QString, QString> DeviceInfo;
 typedef QMap<QString, DeviceInfo> QMapDeviceInfo;
 Q_DECLARE_METATYPE(DeviceInfo)
 Q_DECLARE_METATYPE(QMapDeviceInfo)
 
+// One device in the result of devicesSince()
+struct DeviceEntry
+{
+    QString address;
+    QString name;
+    QString icon;
+    QStringList uuids;
+    // Bitmask of BluetoothServices::Service
+    quint32 services = 0;
+    bool connected = false;
+    bool paired = false;
+    // Rounded to 10 dBm, so that small fluctuations don't count as changes
+    qint16 rssi = 0;
+    bool removed = false;
+};
+
+// Devices added, changed or removed since a generation, D-Bus signature (tba(sssasubbnb))
+struct DeviceChanges
+{
+    quint64 generation = 0;
+    // When true, devices contains all devices instead of only the changed ones
+    bool complete = false;
+    QList<DeviceEntry> devices;
+};
+
+Q_DECLARE_METATYPE(DeviceEntry)
+Q_DECLARE_METATYPE(DeviceChanges)
+
+inline QDBusArgument &operator<<(QDBusArgument &argument, const DeviceEntry &entry)
+{
+    argument.beginStructure();
+    argument << entry.address << entry.name << entry.icon << entry.uuids << entry.services << entry.connected << entry.paired << entry.rssi << entry.removed;
+    argument.endStructure();
+    return argument;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &argument, DeviceEntry &entry)
+{
+    argument.beginStructure();
+    argument >> entry.address >> entry.name >> entry.icon >> entry.uuids >> entry.services >> entry.connected >> entry.paired >> entry.rssi >> entry.removed;
+    argument.endStructure();
+    return argument;
+}
+
+inline QDBusArgument &operator<<(QDBusArgument &argument, const DeviceChanges &changes)
+{
+    argument.beginStructure();
+    argument << changes.generation << changes.complete << changes.devices;
+    argument.endStructure();
+    return argument;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &argument, DeviceChanges &changes)
+{
+    argument.beginStructure();
+    argument >> changes.generation >> changes.complete >> changes.devices;
+    argument.endStructure();
+    return argument;
+}
+
 #endif // KDED_BLUEDEVIL_TYPES_H
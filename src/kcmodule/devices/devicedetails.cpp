@@ -19,6 +19,7 @@
 
 #include "devicedetails.h"
 #include "ui_devicedetails.h"
+#include "../../common/bluetoothservices.h"
 
 #include <QProcess>
 #include <QDBusMessage>
@@ -30,7 +31,6 @@
 
 #include <BluezQt/Device>
 #include <BluezQt/Adapter>
-#include <BluezQt/Services>
 #include <BluezQt/PendingCall>
 
 DeviceDetails::DeviceDetails(QWidget *parent)
@@ -119,12 +119,14 @@ void DeviceDetails::remoteNameChanged(const QString &name)
 
 void DeviceDetails::uuidsChanged(const QStringList &uuids)
 {
-    m_ui->sendFileButton->setVisible(uuids.contains(BluezQt::Services::ObexObjectPush));
+    const BluetoothServices::Services services = BluetoothServices::fromUuids(uuids);
+
+    m_ui->sendFileButton->setVisible(services & BluetoothServices::ObexObjectPush);
 
     m_ui->napButton->hide();
     m_ui->dunButton->hide();
 
-    if (uuids.contains(BluezQt::Services::Nap)) {
+    if (services & BluetoothServices::Nap) {
         checkNetworkConnection(QStringLiteral("nap"), [this](bool exists) {
             if (!exists) {
                 m_ui->napButton->show();
@@ -133,7 +135,7 @@ void DeviceDetails::uuidsChanged(const QStringList &uuids)
         });
     }
 
-    if (uuids.contains(BluezQt::Services::DialupNetworking)) {
+    if (services & BluetoothServices::DialupNetworking) {
         checkNetworkConnection(QStringLiteral("dun"), [this](bool exists) {
             if (!exists) {
                 m_ui->dunButton->show();
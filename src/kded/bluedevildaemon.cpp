@@ -22,14 +22,26 @@
 #include "bluedevildaemon.h"
 #include "bluezagent.h"
 #include "obexftp.h"
+#include "obexopp.h"
+#include "obexpush.h"
+#include "obexreceive.h"
 #include "obexagent.h"
 #include "devicemonitor.h"
+#include "deviceindex.h"
+#include "discoveryarbiter.h"
+#include "transferthrottle.h"
 #include "debug_p.h"
+#include "../common/transferhistory.h"
 #include "version.h"
 
+#include <QHash>
+#include <QList>
 #include <QTimer>
+#include <QDateTime>
 #include <QDBusMetaType>
 
+#include <algorithm>
+
 #include <KAboutData>
 #include <KPluginFactory>
 #include <KLocalizedString>
@@ -54,30 +66,74 @@ struct BlueDevilDaemon::Private
 {
     BluezQt::Manager *m_manager;
     BluezQt::ObexManager *m_obexManager;
+    DeviceIndex *m_deviceIndex;
+    TransferHistory *m_transferHistory;
+    TransferThrottle *m_transferThrottle;
 
-    QTimer m_timer;
+    DiscoveryArbiter *m_discoveryArbiter;
     ObexFtp *m_obexFtp;
+    ObexOpp *m_obexOpp;
+    ObexPush *m_obexPush;
+    ObexReceive *m_obexReceive;
     ObexAgent *m_obexAgent;
     BluezAgent *m_bluezAgent;
     DeviceMonitor *m_deviceMonitor;
+
+    // Generations start at the current time, so that generations from
+    // a previous instance are always older than m_firstGeneration
+    quint64 m_firstGeneration;
+    quint64 m_generation;
+    // Removals up to this generation were forgotten, older clients need a full snapshot
+    quint64 m_pruneGeneration;
+    int m_removedCount;
+    QHash<QString, DeviceEntry> m_devices;
+    QHash<QString, quint64> m_deviceGenerations;
+    QTimer m_devicesChangedTimer;
 };
 
+// Minimum interval between devicesChanged signals
+static const int s_devicesChangedInterval = 250;
+
+// Maximum number of removed devices remembered for devicesSince()
+static const int s_maxRemovedDevices = 64;
+
 BlueDevilDaemon::BlueDevilDaemon(QObject *parent, const QList<QVariant>&)
     : KDEDModule(parent)
     , d(new Private)
 {
     qDBusRegisterMetaType<DeviceInfo>();
     qDBusRegisterMetaType<QMapDeviceInfo>();
+    qDBusRegisterMetaType<DeviceEntry>();
+    qDBusRegisterMetaType<QList<DeviceEntry>>();
+    qDBusRegisterMetaType<DeviceChanges>();
+
+    d->m_firstGeneration = QDateTime::currentMSecsSinceEpoch();
+    d->m_generation = d->m_firstGeneration;
+    d->m_pruneGeneration = d->m_firstGeneration;
+    d->m_removedCount = 0;
 
     d->m_manager = new BluezQt::Manager(this);
     d->m_obexManager = new BluezQt::ObexManager(this);
+    d->m_deviceIndex = new DeviceIndex(d->m_manager, this);
+    d->m_transferHistory = new TransferHistory(QStringLiteral("bluedevil-kded"));
+    d->m_transferThrottle = new TransferThrottle(d->m_manager, d->m_obexManager, this);
     d->m_obexFtp = new ObexFtp(this);
+    d->m_obexOpp = new ObexOpp(this);
+    d->m_obexPush = new ObexPush(this);
     d->m_obexAgent = new ObexAgent(this);
+    d->m_obexReceive = new ObexReceive(this);
     d->m_bluezAgent = new BluezAgent(this);
     d->m_deviceMonitor = new DeviceMonitor(this);
 
-    d->m_timer.setSingleShot(true);
-    connect(&d->m_timer, &QTimer::timeout, this, &BlueDevilDaemon::stopDiscovering);
+    d->m_discoveryArbiter = new DiscoveryArbiter(d->m_manager, this);
+
+    d->m_devicesChangedTimer.setSingleShot(true);
+    d->m_devicesChangedTimer.setInterval(s_devicesChangedInterval);
+    connect(&d->m_devicesChangedTimer, &QTimer::timeout, this, &BlueDevilDaemon::emitDevicesChanged);
+
+    connect(d->m_manager, &BluezQt::Manager::deviceAdded, this, &BlueDevilDaemon::deviceAdded);
+    connect(d->m_manager, &BluezQt::Manager::deviceChanged, this, &BlueDevilDaemon::deviceAdded);
+    connect(d->m_manager, &BluezQt::Manager::deviceRemoved, this, &BlueDevilDaemon::deviceRemoved);
 
     KAboutData aboutData(
         QStringLiteral("bluedevildaemon"),
@@ -121,6 +177,7 @@ BlueDevilDaemon::~BlueDevilDaemon()
 
     qCDebug(BLUEDAEMON) << "Destroyed";
 
+    delete d->m_transferHistory;
     delete d;
 }
 
@@ -142,36 +199,85 @@ QMapDeviceInfo BlueDevilDaemon::allDevices()
 
 DeviceInfo BlueDevilDaemon::device(const QString &address)
 {
-    BluezQt::DevicePtr device = d->m_manager->deviceForAddress(address);
+    BluezQt::DevicePtr device = d->m_deviceIndex->device(address);
     return deviceToInfo(device);
 }
 
-void BlueDevilDaemon::startDiscovering(quint32 timeout)
+quint64 BlueDevilDaemon::generation()
 {
-    if (!d->m_manager->usableAdapter()) {
-        return;
-    }
+    return d->m_generation;
+}
 
-    qCDebug(BLUEDAEMON) << "Start discovering for" << timeout << "ms";
+DeviceChanges BlueDevilDaemon::devicesSince(quint64 generation)
+{
+    DeviceChanges changes;
+    changes.generation = d->m_generation;
+    changes.complete = generation < d->m_pruneGeneration || generation > d->m_generation;
 
-    d->m_manager->usableAdapter()->startDiscovery();
+    if (!changes.complete && generation == d->m_generation) {
+        return changes;
+    }
 
-    if (timeout > 0) {
-        d->m_timer.start(timeout);
+    QHash<QString, quint64>::const_iterator it;
+    for (it = d->m_deviceGenerations.constBegin(); it != d->m_deviceGenerations.constEnd(); ++it) {
+        if (!changes.complete && it.value() <= generation) {
+            continue;
+        }
+
+        const DeviceEntry &entry = d->m_devices.value(it.key());
+        if (changes.complete && entry.removed) {
+            continue;
+        }
+        changes.devices.append(entry);
     }
+
+    return changes;
 }
 
-void BlueDevilDaemon::stopDiscovering()
+void BlueDevilDaemon::startDiscovering(quint32 timeout, const QDBusMessage &msg)
 {
-    if (!d->m_manager->usableAdapter()) {
-        return;
-    }
+    d->m_discoveryArbiter->start(msg.service(), timeout);
+}
 
-    qCDebug(BLUEDAEMON) << "Stop discovering";
+void BlueDevilDaemon::startFilteredDiscovering(quint32 timeout, const QVariantMap &filter, const QDBusMessage &msg)
+{
+    d->m_discoveryArbiter->start(msg.service(), timeout, filter);
+}
 
-    if (d->m_manager->usableAdapter()->isDiscovering()) {
-        d->m_manager->usableAdapter()->stopDiscovery();
+void BlueDevilDaemon::stopDiscovering(const QDBusMessage &msg)
+{
+    d->m_discoveryArbiter->stop(msg.service());
+}
+
+QStringList BlueDevilDaemon::discoveringClients()
+{
+    return d->m_discoveryArbiter->clients();
+}
+
+qint64 BlueDevilDaemon::reconnectDuration()
+{
+    return d->m_deviceMonitor->reconnectDuration();
+}
+
+qint64 BlueDevilDaemon::resumeDuration()
+{
+    return d->m_deviceMonitor->resumeDuration();
+}
+
+quint32 BlueDevilDaemon::deviceServices(const QString &address)
+{
+    return d->m_deviceIndex->services(address);
+}
+
+QStringList BlueDevilDaemon::devicesWithServices(quint32 services, bool connectedOnly)
+{
+    QStringList addresses;
+
+    Q_FOREACH (BluezQt::DevicePtr device, d->m_deviceIndex->devices(BluetoothServices::Services(services), connectedOnly)) {
+        addresses.append(device->address());
     }
+
+    return addresses;
 }
 
 BluezQt::Manager *BlueDevilDaemon::manager() const
@@ -184,6 +290,26 @@ BluezQt::ObexManager *BlueDevilDaemon::obexManager() const
     return d->m_obexManager;
 }
 
+DeviceIndex *BlueDevilDaemon::deviceIndex() const
+{
+    return d->m_deviceIndex;
+}
+
+ObexAgent *BlueDevilDaemon::obexAgent() const
+{
+    return d->m_obexAgent;
+}
+
+TransferHistory *BlueDevilDaemon::transferHistory() const
+{
+    return d->m_transferHistory;
+}
+
+TransferThrottle *BlueDevilDaemon::transferThrottle() const
+{
+    return d->m_transferThrottle;
+}
+
 void BlueDevilDaemon::initJobResult(BluezQt::InitManagerJob *job)
 {
     if (job->error()) {
@@ -191,6 +317,12 @@ void BlueDevilDaemon::initJobResult(BluezQt::InitManagerJob *job)
         return;
     }
 
+    d->m_deviceIndex->reload();
+
+    Q_FOREACH (BluezQt::DevicePtr device, d->m_manager->devices()) {
+        deviceAdded(device);
+    }
+
     operationalChanged(d->m_manager->isOperational());
     connect(d->m_manager, &BluezQt::Manager::operationalChanged, this, &BlueDevilDaemon::operationalChanged);
 }
@@ -262,6 +394,86 @@ void BlueDevilDaemon::obexAgentRegistered(BluezQt::PendingCall *call)
     }
 }
 
+void BlueDevilDaemon::deviceAdded(BluezQt::DevicePtr device)
+{
+    const DeviceEntry &entry = deviceToEntry(device);
+    const DeviceEntry &old = d->m_devices.value(entry.address);
+
+    // deviceChanged is also emitted for properties that are not in the table
+    // (eg. ManufacturerData) and for RSSI changes within the same bucket
+    if (d->m_devices.contains(entry.address) && !old.removed && old.name == entry.name
+            && old.icon == entry.icon && old.uuids == entry.uuids && old.connected == entry.connected
+            && old.paired == entry.paired && old.rssi == entry.rssi) {
+        return;
+    }
+
+    if (old.removed) {
+        d->m_removedCount--;
+    }
+
+    d->m_devices[entry.address] = entry;
+    d->m_deviceGenerations[entry.address] = ++d->m_generation;
+
+    if (!d->m_devicesChangedTimer.isActive()) {
+        d->m_devicesChangedTimer.start();
+    }
+}
+
+void BlueDevilDaemon::deviceRemoved(BluezQt::DevicePtr device)
+{
+    // Removed devices stay in the table, so that devicesSince() can report them
+    DeviceEntry &entry = d->m_devices[device->address()];
+    if (entry.removed) {
+        return;
+    }
+    entry.address = device->address();
+    entry.removed = true;
+
+    d->m_deviceGenerations[entry.address] = ++d->m_generation;
+
+    if (++d->m_removedCount > s_maxRemovedDevices) {
+        pruneRemovedDevices();
+    }
+
+    if (!d->m_devicesChangedTimer.isActive()) {
+        d->m_devicesChangedTimer.start();
+    }
+}
+
+void BlueDevilDaemon::pruneRemovedDevices()
+{
+    QList<quint64> generations;
+
+    QHash<QString, DeviceEntry>::const_iterator it;
+    for (it = d->m_devices.constBegin(); it != d->m_devices.constEnd(); ++it) {
+        if (it->removed) {
+            generations.append(d->m_deviceGenerations.value(it.key()));
+        }
+    }
+
+    // Forget the older half, clients that may have missed one of them get a full snapshot
+    std::sort(generations.begin(), generations.end());
+    d->m_pruneGeneration = qMax(d->m_pruneGeneration, generations.at(generations.size() / 2 - 1));
+
+    QHash<QString, DeviceEntry>::iterator entry = d->m_devices.begin();
+    while (entry != d->m_devices.end()) {
+        if (entry->removed && d->m_deviceGenerations.value(entry.key()) <= d->m_pruneGeneration) {
+            d->m_deviceGenerations.remove(entry.key());
+            entry = d->m_devices.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+
+    d->m_removedCount = generations.size() - generations.size() / 2;
+    qCDebug(BLUEDAEMON) << "Pruned removed devices up to generation" << d->m_pruneGeneration;
+}
+
+void BlueDevilDaemon::emitDevicesChanged()
+{
+    Q_EMIT devicesChanged(d->m_generation);
+}
+
 DeviceInfo BlueDevilDaemon::deviceToInfo(BluezQt::DevicePtr device) const
 {
     DeviceInfo info;
@@ -275,8 +487,23 @@ DeviceInfo BlueDevilDaemon::deviceToInfo(BluezQt::DevicePtr device) const
     info[QStringLiteral("address")] = device->address();
     info[QStringLiteral("UBI")] = device->ubi();
     info[QStringLiteral("UUIDs")] = device->uuids().join(QLatin1Char(','));
+    info[QStringLiteral("Services")] = QString::number(quint32(d->m_deviceIndex->services(device)));
 
     return info;
 }
 
+DeviceEntry BlueDevilDaemon::deviceToEntry(BluezQt::DevicePtr device) const
+{
+    DeviceEntry entry;
+    entry.address = device->address();
+    entry.name = device->name();
+    entry.icon = device->icon();
+    entry.uuids = device->uuids();
+    entry.services = d->m_deviceIndex->services(device);
+    entry.connected = device->isConnected();
+    entry.paired = device->isPaired();
+    entry.rssi = device->rssi() / 10 * 10;
+    return entry;
+}
+
 #include "bluedevildaemon.moc"
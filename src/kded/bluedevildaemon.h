@@ -23,15 +23,19 @@
 #ifndef BLUEDEVILDAEMON_H
 #define BLUEDEVILDAEMON_H
 
-#include <QMap>
+#include "../interfaces/kded_bluedevil_types.h"
+
+#include <QDBusMessage>
 
 #include <KDEDModule>
 
 #include <BluezQt/Manager>
 #include <BluezQt/ObexManager>
 
-typedef QMap<QString, QString> DeviceInfo;
-typedef QMap<QString, DeviceInfo> QMapDeviceInfo;
+class ObexAgent;
+class DeviceIndex;
+class TransferHistory;
+class TransferThrottle;
 
 class Q_DECL_EXPORT BlueDevilDaemon : public KDEDModule
 {
@@ -59,17 +63,79 @@ public:
     Q_SCRIPTABLE DeviceInfo device(const QString &address);
 
     /**
-     * Starts discovery for timeout miliseconds (0 = forever)
+     * Returns the current generation of the device table. It is increased
+     * every time a device is added, removed or its name, icon, UUIDs, connected
+     * or paired state or RSSI (in 10 dBm steps) change.
+     */
+    Q_SCRIPTABLE quint64 generation();
+
+    /**
+     * Returns the devices added, changed or removed after @p generation.
+     * When @p generation is 0, comes from a previous instance of the daemon
+     * or is older than the oldest removal still remembered, all devices are
+     * returned and complete is set.
      */
-    Q_SCRIPTABLE void startDiscovering(quint32 timeout);
+    Q_SCRIPTABLE DeviceChanges devicesSince(quint64 generation);
 
     /**
-     * Stops discovery (if it was previously started)
+     * Starts discovery for timeout miliseconds (0 = until stopped) for the calling client.
+     * Discovery is shared by all clients and runs until the last one doesn't need it.
      */
-    Q_SCRIPTABLE void stopDiscovering();
+    Q_SCRIPTABLE void startDiscovering(quint32 timeout, const QDBusMessage &msg);
+
+    /**
+     * Same as @p startDiscovering, but only finds devices matching @p filter.
+     * The filter uses the keys of BlueZ SetDiscoveryFilter (Transport, RSSI,
+     * Pathloss, UUIDs, DuplicateData).
+     */
+    Q_SCRIPTABLE void startFilteredDiscovering(quint32 timeout, const QVariantMap &filter, const QDBusMessage &msg);
+
+    /**
+     * Stops discovery for the calling client (if it previously started it)
+     */
+    Q_SCRIPTABLE void stopDiscovering(const QDBusMessage &msg);
+
+    /**
+     * Returns D-Bus names of the clients that currently request discovery
+     */
+    Q_SCRIPTABLE QStringList discoveringClients();
+
+    /**
+     * Returns how long (ms) it took to reconnect all previously connected devices
+     * after the last startup, resume or link loss, or -1 when it didn't happen yet.
+     */
+    Q_SCRIPTABLE qint64 reconnectDuration();
+
+    /**
+     * Returns how long (ms) it took from the last resume until all previously
+     * connected devices were reconnected, or -1 when it didn't happen yet.
+     */
+    Q_SCRIPTABLE qint64 resumeDuration();
+
+    /**
+     * Returns the services of a device as a bitmask of BluetoothServices::Service.
+     */
+    Q_SCRIPTABLE quint32 deviceServices(const QString &address);
+
+    /**
+     * Returns addresses of the devices having any of @p services (all devices for 0),
+     * only the connected ones if @p connectedOnly is set.
+     */
+    Q_SCRIPTABLE QStringList devicesWithServices(quint32 services, bool connectedOnly);
 
     BluezQt::Manager *manager() const;
     BluezQt::ObexManager *obexManager() const;
+    DeviceIndex *deviceIndex() const;
+    ObexAgent *obexAgent() const;
+    TransferHistory *transferHistory() const;
+    TransferThrottle *transferThrottle() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when the device table changed, with its new generation.
+     * Changes are batched, the signal is emitted at most 4 times per second.
+     */
+    Q_SCRIPTABLE void devicesChanged(quint64 generation);
 
 private Q_SLOTS:
     void initJobResult(BluezQt::InitManagerJob *job);
@@ -82,8 +148,14 @@ private Q_SLOTS:
     void agentRequestedDefault(BluezQt::PendingCall *call);
     void obexAgentRegistered(BluezQt::PendingCall *call);
 
+    void deviceAdded(BluezQt::DevicePtr device);
+    void deviceRemoved(BluezQt::DevicePtr device);
+    void emitDevicesChanged();
+
 private:
     DeviceInfo deviceToInfo(BluezQt::DevicePtr device) const;
+    DeviceEntry deviceToEntry(BluezQt::DevicePtr device) const;
+    void pruneRemovedDevices();
 
 private:
     struct Private;
@@ -0,0 +1,188 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "deviceindex.h"
+
+#include <BluezQt/Manager>
+#include <BluezQt/Adapter>
+#include <BluezQt/Device>
+
+DeviceIndex::DeviceIndex(BluezQt::Manager *manager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+{
+    connect(m_manager, &BluezQt::Manager::deviceAdded, this, &DeviceIndex::deviceAdded);
+    connect(m_manager, &BluezQt::Manager::deviceRemoved, this, &DeviceIndex::deviceRemoved);
+
+    reload();
+}
+
+void DeviceIndex::reload()
+{
+    QHash<QString, BluetoothServices::Services> oldServices;
+
+    Q_FOREACH (const Entry &entry, m_devices) {
+        entry.device->disconnect(this);
+        oldServices.insert(entry.device->ubi(), entry.services);
+    }
+
+    m_devices.clear();
+    m_byAddress.clear();
+    m_byAdapter.clear();
+    m_connected.clear();
+
+    Q_FOREACH (BluezQt::DevicePtr device, m_manager->devices()) {
+        deviceAdded(device);
+    }
+
+    Q_FOREACH (const Entry &entry, m_devices) {
+        auto it = oldServices.constFind(entry.device->ubi());
+        if (it != oldServices.constEnd() && it.value() != entry.services) {
+            Q_EMIT servicesChanged(entry.device);
+        }
+    }
+}
+
+BluezQt::DevicePtr DeviceIndex::device(const QString &address) const
+{
+    return m_devices.value(m_byAddress.value(address)).device;
+}
+
+BluezQt::DevicePtr DeviceIndex::device(const QString &adapterAddress, const QString &address) const
+{
+    return m_devices.value(m_byAdapter.value(adapterKey(adapterAddress, address))).device;
+}
+
+BluetoothServices::Services DeviceIndex::services(BluezQt::DevicePtr device) const
+{
+    return device ? m_devices.value(device->ubi()).services : BluetoothServices::Services();
+}
+
+BluetoothServices::Services DeviceIndex::services(const QString &address) const
+{
+    return m_devices.value(m_byAddress.value(address)).services;
+}
+
+QList<BluezQt::DevicePtr> DeviceIndex::devices(BluetoothServices::Services services, bool connectedOnly) const
+{
+    QList<BluezQt::DevicePtr> devices;
+
+    auto matches = [services](const Entry &entry) {
+        return !services || (entry.services & services);
+    };
+
+    if (connectedOnly) {
+        Q_FOREACH (const QString &ubi, m_connected) {
+            const Entry &entry = m_devices.value(ubi);
+            if (matches(entry)) {
+                devices.append(entry.device);
+            }
+        }
+    } else {
+        Q_FOREACH (const Entry &entry, m_devices) {
+            if (matches(entry)) {
+                devices.append(entry.device);
+            }
+        }
+    }
+
+    return devices;
+}
+
+void DeviceIndex::deviceAdded(BluezQt::DevicePtr device)
+{
+    if (m_devices.contains(device->ubi())) {
+        return;
+    }
+
+    Entry entry;
+    entry.device = device;
+    entry.services = BluetoothServices::fromUuids(device->uuids());
+    m_devices.insert(device->ubi(), entry);
+
+    m_byAddress.insert(device->address(), device->ubi());
+    m_byAdapter.insert(adapterKey(device->adapter()->address(), device->address()), device->ubi());
+
+    if (device->isConnected()) {
+        m_connected.insert(device->ubi());
+    }
+
+    connect(device.data(), &BluezQt::Device::uuidsChanged, this, &DeviceIndex::deviceUuidsChanged);
+    connect(device.data(), &BluezQt::Device::connectedChanged, this, &DeviceIndex::deviceConnectedChanged);
+}
+
+void DeviceIndex::deviceRemoved(BluezQt::DevicePtr device)
+{
+    if (!m_devices.remove(device->ubi())) {
+        return;
+    }
+
+    // The same device may still be known to another adapter
+    if (m_byAddress.value(device->address()) == device->ubi()) {
+        m_byAddress.remove(device->address());
+
+        Q_FOREACH (const Entry &entry, m_devices) {
+            if (entry.device->address() == device->address()) {
+                m_byAddress.insert(device->address(), entry.device->ubi());
+                break;
+            }
+        }
+    }
+
+    m_byAdapter.remove(adapterKey(device->adapter()->address(), device->address()));
+    m_connected.remove(device->ubi());
+
+    device->disconnect(this);
+}
+
+void DeviceIndex::deviceUuidsChanged(const QStringList &uuids)
+{
+    Q_ASSERT(qobject_cast<BluezQt::Device*>(sender()));
+
+    const QString &ubi = static_cast<BluezQt::Device*>(sender())->ubi();
+
+    auto it = m_devices.find(ubi);
+    if (it == m_devices.end()) {
+        return;
+    }
+
+    const BluetoothServices::Services services = BluetoothServices::fromUuids(uuids);
+    if (it->services != services) {
+        it->services = services;
+        Q_EMIT servicesChanged(it->device);
+    }
+}
+
+void DeviceIndex::deviceConnectedChanged(bool connected)
+{
+    Q_ASSERT(qobject_cast<BluezQt::Device*>(sender()));
+
+    const QString &ubi = static_cast<BluezQt::Device*>(sender())->ubi();
+
+    if (connected) {
+        m_connected.insert(ubi);
+    } else {
+        m_connected.remove(ubi);
+    }
+}
+
+QString DeviceIndex::adapterKey(const QString &adapterAddress, const QString &address)
+{
+    return adapterAddress + QLatin1Char('/') + address;
+}
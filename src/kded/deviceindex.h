@@ -0,0 +1,85 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef DEVICEINDEX_H
+#define DEVICEINDEX_H
+
+#include <QSet>
+#include <QHash>
+#include <QObject>
+
+#include <BluezQt/Types>
+
+#include "../common/bluetoothservices.h"
+
+/**
+ * Indexes the devices of the manager for cheap lookups.
+ *
+ * Devices can be looked up by address, by adapter and address, and filtered
+ * by their services and connected state. The services of a device are kept
+ * as a BluetoothServices bitmask computed once when its UUIDs change.
+ */
+class DeviceIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DeviceIndex(BluezQt::Manager *manager, QObject *parent = nullptr);
+
+    // Indexes all devices of the manager again
+    void reload();
+
+    BluezQt::DevicePtr device(const QString &address) const;
+    BluezQt::DevicePtr device(const QString &adapterAddress, const QString &address) const;
+
+    BluetoothServices::Services services(BluezQt::DevicePtr device) const;
+    BluetoothServices::Services services(const QString &address) const;
+
+    // Devices having any of services (all devices for 0), only the connected ones if connectedOnly
+    QList<BluezQt::DevicePtr> devices(BluetoothServices::Services services, bool connectedOnly = false) const;
+
+Q_SIGNALS:
+    // Emitted after the services of an indexed device changed
+    void servicesChanged(BluezQt::DevicePtr device);
+
+private Q_SLOTS:
+    void deviceAdded(BluezQt::DevicePtr device);
+    void deviceRemoved(BluezQt::DevicePtr device);
+    void deviceUuidsChanged(const QStringList &uuids);
+    void deviceConnectedChanged(bool connected);
+
+private:
+    struct Entry
+    {
+        BluezQt::DevicePtr device;
+        BluetoothServices::Services services;
+    };
+
+    static QString adapterKey(const QString &adapterAddress, const QString &address);
+
+    BluezQt::Manager *m_manager;
+    // By ubi
+    QHash<QString, Entry> m_devices;
+    // Ubis by device address, and by adapter and device address
+    QHash<QString, QString> m_byAddress;
+    QHash<QString, QString> m_byAdapter;
+    QSet<QString> m_connected;
+};
+
+#endif // DEVICEINDEX_H
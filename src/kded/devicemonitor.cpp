@@ -19,9 +19,15 @@
 
 #include "devicemonitor.h"
 #include "bluedevildaemon.h"
+#include "reconnectscheduler.h"
+#include "deviceindex.h"
+#include "linklosstracker.h"
 #include "debug_p.h"
 
 #include <QTimer>
+#include <QDateTime>
+#include <QDBusMessage>
+#include <QPersistentModelIndex>
 
 #include <KDirNotify>
 #include <KConfigGroup>
@@ -30,13 +36,52 @@
 #include <BluezQt/Manager>
 #include <BluezQt/Adapter>
 #include <BluezQt/Device>
-#include <BluezQt/Services>
+#include <BluezQt/PendingCall>
+
+// How long after restoring an adapter its saved powered state is enforced
+static const int s_restoreWindow = 3000;
+
+// Writes of the powered state before giving up
+static const int s_maxRestoreAttempts = 3;
+
+// Delay before rewriting the powered state after a failed write, doubled with every attempt
+static const int s_restoreRetryDelay = 100;
+
+// Delay for batching place changes
+static const int s_placesInterval = 500;
+
+// New devices in bluetooth:/ are announced once none was found for this long,
+// but no later than s_dirNotifyMaxDelay after the first one
+static const int s_dirNotifyInterval = 1000;
+static const int s_dirNotifyMaxDelay = 10000;
+
+static QUrl placeUrl(const QString &address)
+{
+    QUrl url;
+    url.setScheme(QStringLiteral("obexftp"));
+    url.setHost(QString(address).replace(QLatin1Char(':'), QLatin1Char('-')));
+    return url;
+}
 
 DeviceMonitor::DeviceMonitor(BlueDevilDaemon *daemon)
     : QObject(daemon)
     , m_manager(daemon->manager())
+    , m_deviceIndex(daemon->deviceIndex())
     , m_config(KSharedConfig::openConfig(QStringLiteral("bluedevilglobalrc")))
 {
+    m_reconnectScheduler = new ReconnectScheduler(m_manager, this);
+    connect(m_reconnectScheduler, &ReconnectScheduler::batchFinished, this, &DeviceMonitor::reconnectBatchFinished);
+
+    m_linkLossTracker = new LinkLossTracker(this);
+    connect(m_linkLossTracker, &LinkLossTracker::linkLost, this, &DeviceMonitor::deviceLinkLost);
+
+    m_placesTimer.setSingleShot(true);
+    m_placesTimer.setInterval(s_placesInterval);
+    connect(&m_placesTimer, &QTimer::timeout, this, &DeviceMonitor::applyPlaceChanges);
+
+    m_dirNotifyTimer.setSingleShot(true);
+    connect(&m_dirNotifyTimer, &QTimer::timeout, this, &DeviceMonitor::emitDevicesAdded);
+
     Q_FOREACH (BluezQt::AdapterPtr adapter, m_manager->adapters()) {
         adapterAdded(adapter);
     }
@@ -46,9 +91,14 @@ DeviceMonitor::DeviceMonitor(BlueDevilDaemon *daemon)
     }
 
     connect(m_manager, &BluezQt::Manager::adapterAdded, this, &DeviceMonitor::adapterAdded);
+    connect(m_manager, &BluezQt::Manager::adapterRemoved, this, &DeviceMonitor::adapterRemoved);
     connect(m_manager, &BluezQt::Manager::deviceAdded, this, &DeviceMonitor::deviceAdded);
+    connect(m_manager, &BluezQt::Manager::deviceRemoved, this, &DeviceMonitor::deviceRemoved);
     connect(m_manager, &BluezQt::Manager::bluetoothOperationalChanged, this, &DeviceMonitor::bluetoothOperationalChanged);
 
+    // Not Device::uuidsChanged, the index may not have updated the services yet
+    connect(m_deviceIndex, &DeviceIndex::servicesChanged, this, &DeviceMonitor::deviceServicesChanged);
+
     // Catch suspend/resume events
     QDBusConnection::systemBus().connect(QStringLiteral("org.freedesktop.login1"),
                                          QStringLiteral("/org/freedesktop/login1"),
@@ -58,16 +108,16 @@ DeviceMonitor::DeviceMonitor(BlueDevilDaemon *daemon)
                                          SLOT(login1PrepareForSleep(bool))
                                          );
 
-    restoreState();
-}
-
-KFilePlacesModel *DeviceMonitor::places()
-{
-    if (!m_places) {
-        m_places = new KFilePlacesModel(this);
-    }
+    // Catch link loss, newer BlueZ versions tell why a device got disconnected
+    QDBusConnection::systemBus().connect(QStringLiteral("org.bluez"),
+                                         QString(),
+                                         QStringLiteral("org.bluez.Device1"),
+                                         QStringLiteral("Disconnected"),
+                                         this,
+                                         SLOT(deviceDisconnected(QDBusMessage))
+                                         );
 
-    return m_places;
+    restoreState();
 }
 
 void DeviceMonitor::bluetoothOperationalChanged(bool operational)
@@ -79,42 +129,147 @@ void DeviceMonitor::bluetoothOperationalChanged(bool operational)
 
 void DeviceMonitor::adapterAdded(BluezQt::AdapterPtr adapter)
 {
-    // Workaround bluez-qt not registering the powered change after resume from suspend
-    QTimer::singleShot(1000, this, [this, adapter]() {
-        restoreAdapter(adapter);
-    });
+    connect(adapter.data(), &BluezQt::Adapter::poweredChanged, this, &DeviceMonitor::adapterPoweredChanged);
+
+    restoreAdapter(adapter);
+}
+
+void DeviceMonitor::adapterRemoved(BluezQt::AdapterPtr adapter)
+{
+    m_adapterRestores.remove(adapter->ubi());
+}
+
+void DeviceMonitor::adapterPoweredChanged(bool powered)
+{
+    Q_ASSERT(qobject_cast<BluezQt::Adapter*>(sender()));
+
+    BluezQt::AdapterPtr adapter = static_cast<BluezQt::Adapter*>(sender())->toSharedPtr();
+
+    // bluetoothd may apply its own powered state right after the adapter appears
+    // or after resume, so rewrite ours if it didn't stick
+    auto it = m_adapterRestores.find(adapter->ubi());
+    if (it != m_adapterRestores.end()) {
+        const bool savedPowered = savedAdapterPowered(adapter);
+
+        if (powered != savedPowered && it->deadline > QDateTime::currentMSecsSinceEpoch()) {
+            if (it->attempts < s_maxRestoreAttempts) {
+                qCDebug(BLUEDAEMON) << "Powered state of" << adapter->address() << "didn't stick, restoring again";
+                writeAdapterPowered(adapter, savedPowered);
+            } else {
+                qCWarning(BLUEDAEMON) << "Giving up restoring powered state of" << adapter->address();
+                m_adapterRestores.erase(it);
+            }
+            return;
+        }
+    }
+
+    if (powered) {
+        adapterReady(adapter);
+    }
 }
 
 void DeviceMonitor::deviceAdded(BluezQt::DevicePtr device)
 {
     updateDevicePlace(device);
-    org::kde::KDirNotify::emitFilesAdded(QUrl(QStringLiteral("bluetooth:/")));
+    notifyDeviceAdded(device);
 
     connect(device.data(), &BluezQt::Device::connectedChanged, this, &DeviceMonitor::deviceConnectedChanged);
 }
 
+void DeviceMonitor::deviceRemoved(BluezQt::DevicePtr device)
+{
+    m_linkLossTracker->remove(device->ubi());
+    m_listedDevices.remove(device->ubi());
+}
+
+void DeviceMonitor::deviceServicesChanged(BluezQt::DevicePtr device)
+{
+    // Services of new devices are often only known after they were added
+    notifyDeviceAdded(device);
+}
+
+void DeviceMonitor::notifyDeviceAdded(BluezQt::DevicePtr device)
+{
+    // kio_bluetooth only lists devices with supported services
+    if (m_listedDevices.contains(device->ubi()) || !(m_deviceIndex->services(device) & BluetoothServices::ObexServices)) {
+        return;
+    }
+
+    m_listedDevices.insert(device->ubi());
+
+    // A discovery burst is listed once at its end, long discoveries still
+    // get listed every s_dirNotifyMaxDelay
+    if (!m_dirNotifyTimer.isActive()) {
+        m_dirNotifyTime.start();
+    }
+
+    const qint64 remaining = s_dirNotifyMaxDelay - m_dirNotifyTime.elapsed();
+    m_dirNotifyTimer.start(static_cast<int>(qBound<qint64>(0, remaining, s_dirNotifyInterval)));
+}
+
+void DeviceMonitor::emitDevicesAdded()
+{
+    m_dirNotifyTime.invalidate();
+    org::kde::KDirNotify::emitFilesAdded(QUrl(QStringLiteral("bluetooth:/")));
+}
+
 void DeviceMonitor::deviceConnectedChanged(bool connected)
 {
-    Q_UNUSED(connected)
     Q_ASSERT(qobject_cast<BluezQt::Device*>(sender()));
 
     BluezQt::DevicePtr device = static_cast<BluezQt::Device*>(sender())->toSharedPtr();
     updateDevicePlace(device);
+    m_linkLossTracker->connectedChanged(device->ubi(), connected);
+
+    if (connected) {
+        KConfigGroup devicesGroup = m_config->group("Devices");
+        const QString key = QStringLiteral("%1_lastConnected").arg(device->address());
+        devicesGroup.writeEntry<qint64>(key, QDateTime::currentMSecsSinceEpoch());
+    }
+}
+
+void DeviceMonitor::deviceDisconnected(const QDBusMessage &msg)
+{
+    BluezQt::DevicePtr device = m_manager->deviceForUbi(msg.path());
+    if (!device || !device->isPaired()) {
+        return;
+    }
+
+    m_linkLossTracker->disconnected(device->ubi(), msg.arguments().value(0).toString(), device->isConnected());
+}
+
+void DeviceMonitor::deviceLinkLost(const QString &ubi)
+{
+    BluezQt::DevicePtr device = m_manager->deviceForUbi(ubi);
+    if (!device) {
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Link lost to" << device->address();
+    scheduleReconnect(device);
 }
 
 void DeviceMonitor::login1PrepareForSleep(bool active)
 {
     if (active) {
         qCDebug(BLUEDAEMON) << "About to suspend";
+        m_reconnectScheduler->clear();
         saveState();
     } else {
         qCDebug(BLUEDAEMON) << "About to resume";
+        m_resumeTime.start();
         restoreState();
     }
 }
 
 void DeviceMonitor::saveState()
 {
+    // Write pending place changes, kded may exit before the timer fires
+    if (m_placesTimer.isActive()) {
+        m_placesTimer.stop();
+        applyPlaceChanges();
+    }
+
     KConfigGroup adaptersGroup = m_config->group("Adapters");
 
     Q_FOREACH (BluezQt::AdapterPtr adapter, m_manager->adapters()) {
@@ -136,70 +291,268 @@ void DeviceMonitor::saveState()
     m_config->sync();
 }
 
+qint64 DeviceMonitor::reconnectDuration() const
+{
+    return m_reconnectScheduler->lastBatchDuration();
+}
+
+qint64 DeviceMonitor::resumeDuration() const
+{
+    return m_resumeDuration;
+}
+
+void DeviceMonitor::reconnectBatchFinished(qint64 msecs, bool allConnected)
+{
+    Q_UNUSED(msecs)
+
+    if (!m_resumeTime.isValid() || !m_deferredReconnects.isEmpty()) {
+        return;
+    }
+
+    m_resumeDuration = m_resumeTime.elapsed();
+    m_resumeTime.invalidate();
+
+    qCDebug(BLUEDAEMON) << "Devices reconnected" << m_resumeDuration << "ms after resume, all connected:" << allConnected;
+}
+
 void DeviceMonitor::restoreState()
 {
-    KConfigGroup adaptersGroup = m_config->group("Adapters");
+    m_deferredReconnects.clear();
 
     Q_FOREACH (BluezQt::AdapterPtr adapter, m_manager->adapters()) {
-        const QString key = QStringLiteral("%1_powered").arg(adapter->address());
-        adapter->setPowered(adaptersGroup.readEntry<bool>(key, true));
+        restoreAdapter(adapter);
     }
 
     KConfigGroup devicesGroup = m_config->group("Devices");
     const QStringList &connectedDevices = devicesGroup.readEntry<QStringList>(QStringLiteral("connectedDevices"), QStringList());
 
+    bool reconnecting = false;
+
     Q_FOREACH (const QString &addr, connectedDevices) {
         BluezQt::DevicePtr device = m_manager->deviceForAddress(addr);
-        if (device) {
-            device->connectToDevice();
+        if (!device || device->isConnected()) {
+            continue;
         }
+
+        reconnecting = true;
+
+        // Paging a device before its adapter is powered would only fail
+        if (device->adapter()->isPowered()) {
+            scheduleReconnect(device);
+        } else {
+            m_deferredReconnects.append(device->ubi());
+        }
+    }
+
+    if (!reconnecting) {
+        m_resumeTime.invalidate();
     }
 }
 
 void DeviceMonitor::restoreAdapter(BluezQt::AdapterPtr adapter)
+{
+    AdapterRestore restore;
+    restore.deadline = QDateTime::currentMSecsSinceEpoch() + s_restoreWindow;
+    m_adapterRestores.insert(adapter->ubi(), restore);
+    scheduleRestoreCheck(adapter->ubi());
+
+    const bool savedPowered = savedAdapterPowered(adapter);
+
+    // The cached powered state may be stale right after resume, so always write it
+    writeAdapterPowered(adapter, savedPowered);
+
+    if (savedPowered && adapter->isPowered()) {
+        adapterReady(adapter);
+    }
+}
+
+void DeviceMonitor::writeAdapterPowered(BluezQt::AdapterPtr adapter, bool powered)
+{
+    AdapterRestore &restore = m_adapterRestores[adapter->ubi()];
+    const int attempt = restore.attempts++;
+
+    BluezQt::PendingCall *call = adapter->setPowered(powered);
+    connect(call, &BluezQt::PendingCall::finished, this, [this, adapter, powered, attempt](BluezQt::PendingCall *call) {
+        if (!call->error() || !m_adapterRestores.contains(adapter->ubi())) {
+            return;
+        }
+
+        if (attempt + 1 >= s_maxRestoreAttempts) {
+            qCWarning(BLUEDAEMON) << "Error restoring powered state of" << adapter->address() << call->errorText();
+            m_adapterRestores.remove(adapter->ubi());
+            return;
+        }
+
+        QTimer::singleShot(s_restoreRetryDelay << attempt, this, [this, adapter, powered]() {
+            if (m_adapterRestores.contains(adapter->ubi()) && adapter->isPowered() != powered) {
+                writeAdapterPowered(adapter, powered);
+            }
+        });
+    });
+}
+
+void DeviceMonitor::scheduleRestoreCheck(const QString &ubi)
+{
+    QTimer::singleShot(s_restoreWindow, this, [this, ubi]() {
+        checkAdapterRestore(ubi);
+    });
+}
+
+void DeviceMonitor::checkAdapterRestore(const QString &ubi)
+{
+    auto it = m_adapterRestores.find(ubi);
+
+    // The window was extended by a later restore, its own check comes later
+    if (it == m_adapterRestores.end() || it->deadline > QDateTime::currentMSecsSinceEpoch()) {
+        return;
+    }
+
+    BluezQt::AdapterPtr adapter = m_manager->adapterForUbi(ubi);
+    if (!adapter) {
+        m_adapterRestores.erase(it);
+        return;
+    }
+
+    // A write may report success without the state sticking and without
+    // any poweredChanged following, so compare once the window is over
+    const bool savedPowered = savedAdapterPowered(adapter);
+    if (adapter->isPowered() == savedPowered) {
+        m_adapterRestores.erase(it);
+        return;
+    }
+
+    if (it->attempts >= s_maxRestoreAttempts) {
+        qCWarning(BLUEDAEMON) << "Giving up restoring powered state of" << adapter->address();
+        m_adapterRestores.erase(it);
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Powered state of" << adapter->address() << "didn't stick, restoring again";
+    it->deadline = QDateTime::currentMSecsSinceEpoch() + s_restoreWindow;
+    writeAdapterPowered(adapter, savedPowered);
+    scheduleRestoreCheck(ubi);
+}
+
+bool DeviceMonitor::savedAdapterPowered(BluezQt::AdapterPtr adapter)
 {
     KConfigGroup adaptersGroup = m_config->group("Adapters");
 
     const QString &key = QStringLiteral("%1_powered").arg(adapter->address());
-    adapter->setPowered(adaptersGroup.readEntry<bool>(key, true));
+    return adaptersGroup.readEntry<bool>(key, true);
 }
 
-void DeviceMonitor::clearPlaces()
+void DeviceMonitor::adapterReady(BluezQt::AdapterPtr adapter)
 {
-    for (int i = 0; i < places()->rowCount(); ++i) {
-        const QModelIndex &index = places()->index(i, 0);
-        if (places()->url(index).scheme() == QLatin1String("obexftp")) {
-            places()->removePlace(index);
-            i--;
+    for (int i = 0; i < m_deferredReconnects.count();) {
+        BluezQt::DevicePtr device = m_manager->deviceForUbi(m_deferredReconnects.at(i));
+
+        if (!device) {
+            m_deferredReconnects.removeAt(i);
+        } else if (device->adapter() == adapter) {
+            m_deferredReconnects.removeAt(i);
+            scheduleReconnect(device);
+        } else {
+            ++i;
         }
     }
 }
 
+void DeviceMonitor::scheduleReconnect(BluezQt::DevicePtr device)
+{
+    KConfigGroup devicesGroup = m_config->group("Devices");
+
+    const QString &key = QStringLiteral("%1_lastConnected").arg(device->address());
+    m_reconnectScheduler->schedule(device, devicesGroup.readEntry<qint64>(key, 0));
+}
+
+void DeviceMonitor::clearPlaces()
+{
+    m_placeChanges.clear();
+    m_clearPlaces = true;
+    m_placesTimer.start();
+}
+
 void DeviceMonitor::updateDevicePlace(BluezQt::DevicePtr device)
 {
-    if (!device->uuids().contains(BluezQt::Services::ObexFileTransfer)) {
+    if (!(m_deviceIndex->services(device) & BluetoothServices::ObexFileTransfer)) {
         return;
     }
 
-    QUrl url;
-    url.setScheme(QStringLiteral("obexftp"));
-    url.setHost(device->address().replace(QLatin1Char(':'), QLatin1Char('-')));
+    PlaceChange change;
+    change.add = device->isConnected();
 
-    const QModelIndex &index = places()->closestItem(url);
+    if (change.add) {
+        change.name = device->name();
+        change.icon = device->icon();
+        if (change.icon == QLatin1String("phone")) {
+            change.icon.prepend(QLatin1String("smart")); // Better breeze icon
+        }
+    }
 
-    if (device->isConnected()) {
-        if (places()->url(index) != url) {
-            qCDebug(BLUEDAEMON) << "Adding place" << url;
-            QString icon = device->icon();
-            if (icon == QLatin1String("phone")) {
-                icon.prepend(QLatin1String("smart")); // Better breeze icon
+    m_placeChanges.insert(placeUrl(device->address()).host(), change);
+    m_placesTimer.start();
+}
+
+void DeviceMonitor::applyPlaceChanges()
+{
+    // Drop changes that wouldn't change anything, to avoid loading the places at all
+    if (m_placeHostsValid) {
+        if (m_clearPlaces && m_placeHosts.isEmpty()) {
+            m_clearPlaces = false;
+        }
+
+        for (auto it = m_placeChanges.begin(); it != m_placeChanges.end();) {
+            if (!m_clearPlaces && it->add == m_placeHosts.contains(it.key())) {
+                it = m_placeChanges.erase(it);
+            } else {
+                ++it;
             }
-            places()->addPlace(device->name(), url, icon);
         }
-    } else {
-        if (places()->url(index) == url) {
+    }
+
+    if (m_placeChanges.isEmpty() && !m_clearPlaces) {
+        return;
+    }
+
+    KFilePlacesModel places;
+    QHash<QString, QPersistentModelIndex> index;
+
+    for (int i = 0; i < places.rowCount(); ++i) {
+        const QModelIndex &placeIndex = places.index(i, 0);
+        const QUrl &url = places.url(placeIndex);
+        if (url.scheme() == QLatin1String("obexftp")) {
+            index.insert(url.host(), QPersistentModelIndex(placeIndex));
+        }
+    }
+
+    if (m_clearPlaces) {
+        qCDebug(BLUEDAEMON) << "Removing all places";
+        Q_FOREACH (const QPersistentModelIndex &placeIndex, index) {
+            places.removePlace(placeIndex);
+        }
+        index.clear();
+    }
+
+    for (auto it = m_placeChanges.constBegin(); it != m_placeChanges.constEnd(); ++it) {
+        QUrl url;
+        url.setScheme(QStringLiteral("obexftp"));
+        url.setHost(it.key());
+
+        if (it->add && !index.contains(it.key())) {
+            qCDebug(BLUEDAEMON) << "Adding place" << url;
+            places.addPlace(it->name, url, it->icon);
+            index.insert(it.key(), QPersistentModelIndex());
+        } else if (!it->add && index.contains(it.key())) {
             qCDebug(BLUEDAEMON) << "Removing place" << url;
-            places()->removePlace(index);
+            places.removePlace(index.take(it.key()));
         }
     }
+
+    m_placeHosts.clear();
+    for (auto it = index.constBegin(); it != index.constEnd(); ++it) {
+        m_placeHosts.insert(it.key());
+    }
+    m_placeHostsValid = true;
+    m_placeChanges.clear();
+    m_clearPlaces = false;
 }
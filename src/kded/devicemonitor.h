@@ -20,15 +20,23 @@
 #ifndef DEVICEMONITOR_H
 #define DEVICEMONITOR_H
 
+#include <QSet>
+#include <QHash>
+#include <QTimer>
 #include <QObject>
+#include <QStringList>
+#include <QElapsedTimer>
 
 #include <KSharedConfig>
 
 #include <BluezQt/Types>
 
-class KFilePlacesModel;
+class QDBusMessage;
 
 class BlueDevilDaemon;
+class ReconnectScheduler;
+class DeviceIndex;
+class LinkLossTracker;
 
 class DeviceMonitor : public QObject
 {
@@ -39,26 +47,82 @@ public:
 
     void saveState();
 
+    // Time (ms) it took to reconnect all devices last time, -1 if unknown
+    qint64 reconnectDuration() const;
+
+    // Time (ms) from the last resume until all devices were reconnected, -1 if unknown
+    qint64 resumeDuration() const;
+
 private Q_SLOTS:
     void bluetoothOperationalChanged(bool operational);
     void adapterAdded(BluezQt::AdapterPtr adapter);
+    void adapterRemoved(BluezQt::AdapterPtr adapter);
+    void adapterPoweredChanged(bool powered);
     void deviceAdded(BluezQt::DevicePtr device);
+    void deviceRemoved(BluezQt::DevicePtr device);
+    void deviceServicesChanged(BluezQt::DevicePtr device);
 
     void deviceConnectedChanged(bool connected);
+    void deviceDisconnected(const QDBusMessage &msg);
+    void deviceLinkLost(const QString &ubi);
     void login1PrepareForSleep(bool active);
+    void reconnectBatchFinished(qint64 msecs, bool allConnected);
+    void applyPlaceChanges();
+    void emitDevicesAdded();
 
 private:
     void restoreState();
     void restoreAdapter(BluezQt::AdapterPtr adapter);
+    void writeAdapterPowered(BluezQt::AdapterPtr adapter, bool powered);
+    bool savedAdapterPowered(BluezQt::AdapterPtr adapter);
+    void scheduleRestoreCheck(const QString &ubi);
+    void checkAdapterRestore(const QString &ubi);
+    void adapterReady(BluezQt::AdapterPtr adapter);
+    void scheduleReconnect(BluezQt::DevicePtr device);
 
     void clearPlaces();
     void updateDevicePlace(BluezQt::DevicePtr device);
-
-    KFilePlacesModel *places();
+    void notifyDeviceAdded(BluezQt::DevicePtr device);
 
     BluezQt::Manager *m_manager;
-    KFilePlacesModel *m_places = nullptr;
+    DeviceIndex *m_deviceIndex;
+    ReconnectScheduler *m_reconnectScheduler;
+    LinkLossTracker *m_linkLossTracker;
     KSharedConfig::Ptr m_config;
+
+    struct AdapterRestore
+    {
+        // ms since epoch until which the saved powered state is enforced
+        qint64 deadline = 0;
+        int attempts = 0;
+    };
+
+    struct PlaceChange
+    {
+        bool add = false;
+        QString name;
+        QString icon;
+    };
+
+    // Place changes waiting for m_placesTimer, by url host
+    QHash<QString, PlaceChange> m_placeChanges;
+    bool m_clearPlaces = false;
+    // Hosts of the obexftp places after the last applyPlaceChanges
+    QSet<QString> m_placeHosts;
+    bool m_placeHostsValid = false;
+    QTimer m_placesTimer;
+
+    // Devices already announced to bluetooth:/ views, by ubi
+    QSet<QString> m_listedDevices;
+    QTimer m_dirNotifyTimer;
+    // Since the first device waiting for m_dirNotifyTimer
+    QElapsedTimer m_dirNotifyTime;
+
+    QHash<QString, AdapterRestore> m_adapterRestores;
+    // Devices to reconnect once their adapter is powered
+    QStringList m_deferredReconnects;
+    QElapsedTimer m_resumeTime;
+    qint64 m_resumeDuration = -1;
 };
 
 #endif // DEVICEMONITOR_H
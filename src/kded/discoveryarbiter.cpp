@@ -0,0 +1,165 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "discoveryarbiter.h"
+#include "debug_p.h"
+#include "../common/discoveryfilter.h"
+
+#include <QDateTime>
+#include <QDBusConnection>
+#include <QDBusServiceWatcher>
+
+#include <BluezQt/Manager>
+#include <BluezQt/Adapter>
+
+DiscoveryArbiter::DiscoveryArbiter(BluezQt::Manager *manager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_discovering(false)
+{
+    m_serviceWatcher = new QDBusServiceWatcher(this);
+    m_serviceWatcher->setConnection(QDBusConnection::sessionBus());
+    m_serviceWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &DiscoveryArbiter::stop);
+    connect(m_manager, &BluezQt::Manager::usableAdapterChanged, this, &DiscoveryArbiter::usableAdapterChanged);
+
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &DiscoveryArbiter::expireClients);
+}
+
+void DiscoveryArbiter::start(const QString &client, quint32 timeout, const QVariantMap &filter)
+{
+    qCDebug(BLUEDAEMON) << "Start discovering for" << client << timeout << "ms" << filter;
+
+    Client c;
+    c.deadline = timeout > 0 ? QDateTime::currentMSecsSinceEpoch() + timeout : 0;
+    c.filter = filter;
+
+    // A new request replaces the previous one of the same client
+    m_clients.insert(client, c);
+
+    if (!client.isEmpty()) {
+        m_serviceWatcher->addWatchedService(client);
+    }
+
+    update();
+}
+
+void DiscoveryArbiter::stop(const QString &client)
+{
+    if (!m_clients.contains(client)) {
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Stop discovering for" << client;
+
+    removeClient(client);
+    update();
+}
+
+QStringList DiscoveryArbiter::clients() const
+{
+    return m_clients.keys();
+}
+
+void DiscoveryArbiter::expireClients()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    Q_FOREACH (const QString &client, m_clients.keys()) {
+        const qint64 deadline = m_clients.value(client).deadline;
+        if (deadline > 0 && deadline <= now) {
+            qCDebug(BLUEDAEMON) << "Discovery expired for" << client;
+            removeClient(client);
+        }
+    }
+
+    update();
+}
+
+void DiscoveryArbiter::usableAdapterChanged(BluezQt::AdapterPtr adapter)
+{
+    // Discovery ends with the adapter, continue on the new one
+    m_discovering = false;
+    m_filter.clear();
+
+    if (adapter) {
+        update();
+    }
+}
+
+void DiscoveryArbiter::removeClient(const QString &client)
+{
+    m_clients.remove(client);
+
+    if (!client.isEmpty()) {
+        m_serviceWatcher->removeWatchedService(client);
+    }
+}
+
+void DiscoveryArbiter::update()
+{
+    BluezQt::AdapterPtr adapter = m_manager->usableAdapter();
+
+    if (m_clients.isEmpty()) {
+        m_timer.stop();
+
+        if (m_discovering && adapter && adapter->isDiscovering()) {
+            qCDebug(BLUEDAEMON) << "Stop discovering, no clients left";
+            adapter->stopDiscovery();
+        }
+        m_discovering = false;
+        return;
+    }
+
+    // Wake up at the earliest deadline
+    qint64 nextDeadline = 0;
+    QList<QVariantMap> filters;
+    Q_FOREACH (const Client &client, m_clients) {
+        if (client.deadline > 0 && (nextDeadline == 0 || client.deadline < nextDeadline)) {
+            nextDeadline = client.deadline;
+        }
+        filters.append(client.filter);
+    }
+
+    if (nextDeadline > 0) {
+        m_timer.start(qMax<qint64>(0, nextDeadline - QDateTime::currentMSecsSinceEpoch()));
+    } else {
+        m_timer.stop();
+    }
+
+    if (!adapter) {
+        return;
+    }
+
+    // The filter can be changed while discovering
+    const QVariantMap filter = DiscoveryFilter::merge(filters);
+    if (filter != m_filter || !m_discovering) {
+        qCDebug(BLUEDAEMON) << "Setting discovery filter" << filter;
+        DiscoveryFilter::apply(adapter->ubi(), filter);
+        m_filter = filter;
+    }
+
+    if (!m_discovering) {
+        qCDebug(BLUEDAEMON) << "Start discovering for clients" << m_clients.keys();
+        adapter->startDiscovery();
+        m_discovering = true;
+    }
+}
@@ -0,0 +1,78 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef DISCOVERYARBITER_H
+#define DISCOVERYARBITER_H
+
+#include <QHash>
+#include <QTimer>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <BluezQt/Types>
+
+class QDBusServiceWatcher;
+
+/**
+ * Shares one adapter discovery between all clients that asked for it.
+ *
+ * Every client (identified by its D-Bus unique name) gets its own deadline
+ * and discovery filter. Discovery runs while at least one client still needs it,
+ * and stops as soon as the last client stops it, its deadline expires or it quits.
+ * The adapter uses a filter that finds what every client asked for.
+ */
+class DiscoveryArbiter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DiscoveryArbiter(BluezQt::Manager *manager, QObject *parent = nullptr);
+
+    // Starts discovery for client for timeout ms (0 = until the client stops it)
+    void start(const QString &client, quint32 timeout, const QVariantMap &filter = QVariantMap());
+    void stop(const QString &client);
+
+    // Clients currently requesting discovery
+    QStringList clients() const;
+
+private Q_SLOTS:
+    void expireClients();
+    void usableAdapterChanged(BluezQt::AdapterPtr adapter);
+
+private:
+    struct Client
+    {
+        // ms since epoch, 0 = no deadline
+        qint64 deadline = 0;
+        QVariantMap filter;
+    };
+
+    void removeClient(const QString &client);
+    void update();
+
+    BluezQt::Manager *m_manager;
+    QDBusServiceWatcher *m_serviceWatcher;
+    QHash<QString, Client> m_clients;
+    QVariantMap m_filter;
+    QTimer m_timer;
+    bool m_discovering;
+};
+
+#endif // DISCOVERYARBITER_H
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "filehasher.h"
+
+#include <limits>
+
+// Bytes read and hashed at once
+static const quint64 s_chunkSize = 1024 * 1024;
+
+FileHasher::FileHasher(const QString &filePath)
+    : m_file(filePath)
+    , m_hash(QCryptographicHash::Sha256)
+    , m_hashed(0)
+{
+}
+
+void FileHasher::update(quint64 available)
+{
+    read(available);
+}
+
+void FileHasher::finish()
+{
+    read(std::numeric_limits<quint64>::max());
+    m_file.close();
+
+    Q_EMIT finished(m_hash.result(), m_hashed);
+}
+
+void FileHasher::read(quint64 available)
+{
+    if (!m_file.isOpen() && !m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    // The data was just written, so reading it back comes from the page cache
+    while (m_hashed < available) {
+        const QByteArray data = m_file.read(qMin(available - m_hashed, s_chunkSize));
+        if (data.isEmpty()) {
+            break;
+        }
+        m_hash.addData(data);
+        m_hashed += data.size();
+    }
+}
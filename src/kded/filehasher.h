@@ -0,0 +1,59 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef FILEHASHER_H
+#define FILEHASHER_H
+
+#include <QFile>
+#include <QObject>
+#include <QCryptographicHash>
+
+/**
+ * Hashes a file while it is being written.
+ *
+ * Lives in a worker thread, so that reading the data back doesn't block
+ * kded. update() and finish() are meant to be invoked with a queued
+ * connection, the result arrives with the finished signal.
+ */
+class FileHasher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileHasher(const QString &filePath);
+
+public Q_SLOTS:
+    // Hashes the data up to available bytes
+    void update(quint64 available);
+
+    // Hashes the rest of the file and emits finished
+    void finish();
+
+Q_SIGNALS:
+    void finished(const QByteArray &hash, quint64 size);
+
+private:
+    void read(quint64 available);
+
+    QFile m_file;
+    QCryptographicHash m_hash;
+    quint64 m_hashed;
+};
+
+#endif // FILEHASHER_H
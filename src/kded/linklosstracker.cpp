@@ -0,0 +1,52 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "linklosstracker.h"
+
+LinkLossTracker::LinkLossTracker(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void LinkLossTracker::disconnected(const QString &ubi, const QString &reason, bool connected)
+{
+    if (reason != QLatin1String("org.bluez.Reason.Timeout")) {
+        m_pending.remove(ubi);
+        return;
+    }
+
+    // Connected is normally still true here, but don't rely on the order
+    if (connected) {
+        m_pending.insert(ubi);
+    } else {
+        Q_EMIT linkLost(ubi);
+    }
+}
+
+void LinkLossTracker::connectedChanged(const QString &ubi, bool connected)
+{
+    if (m_pending.remove(ubi) && !connected) {
+        Q_EMIT linkLost(ubi);
+    }
+}
+
+void LinkLossTracker::remove(const QString &ubi)
+{
+    m_pending.remove(ubi);
+}
@@ -0,0 +1,58 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef LINKLOSSTRACKER_H
+#define LINKLOSSTRACKER_H
+
+#include <QSet>
+#include <QObject>
+
+/**
+ * Detects devices that dropped out of range.
+ *
+ * BlueZ reports the reason of a disconnect with the Device1.Disconnected
+ * signal, which arrives before Connected changes to false. The device is
+ * remembered on a timeout and linkLost is emitted once it is really
+ * disconnected, so that a reconnect attempt doesn't see it still connected.
+ */
+class LinkLossTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LinkLossTracker(QObject *parent = nullptr);
+
+    // Device1.Disconnected was received, connected is the current Connected property
+    void disconnected(const QString &ubi, const QString &reason, bool connected);
+
+    // Connected property of the device changed
+    void connectedChanged(const QString &ubi, bool connected);
+
+    // Forgets the device
+    void remove(const QString &ubi);
+
+Q_SIGNALS:
+    void linkLost(const QString &ubi);
+
+private:
+    // Devices that timed out but are still reported as connected
+    QSet<QString> m_pending;
+};
+
+#endif // LINKLOSSTRACKER_H
@@ -19,16 +19,48 @@
 
 #include "obexagent.h"
 #include "receivefilejob.h"
+#include "receivebatchjob.h"
+#include "receivedfilesindex.h"
 #include "bluedevildaemon.h"
+#include "transferthrottle.h"
 #include "filereceiversettings.h"
 #include "debug_p.h"
+#include "../common/transferhistory.h"
 
+#include <QStorageInfo>
+#include <QStandardPaths>
 #include <QDBusObjectPath>
 
+#include <BluezQt/ObexSession>
+#include <BluezQt/ObexTransfer>
+
+// obexd gives up waiting for the agent after 60 seconds
+static const int s_queueTimeout = 50;
+
 ObexAgent::ObexAgent(BlueDevilDaemon *daemon)
     : BluezQt::ObexAgent(daemon)
     , m_manager(daemon->manager())
+    , m_receivedFilesIndex(new ReceivedFilesIndex)
+    , m_history(daemon->transferHistory())
+    , m_throttle(daemon->transferThrottle())
+    , m_deviceIndex(daemon->deviceIndex())
 {
+    m_queueTimer.setInterval(1000);
+    connect(&m_queueTimer, &QTimer::timeout, this, &ObexAgent::expireQueuedPushes);
+
+    connect(m_throttle, &TransferThrottle::activeChanged, this, [this](bool active) {
+        if (!active) {
+            startQueuedPushes();
+        }
+    });
+}
+
+ObexAgent::~ObexAgent()
+{
+    m_hashThread.quit();
+    m_hashThread.wait();
+
+    delete m_receivedFilesIndex;
 }
 
 BluezQt::Manager *ObexAgent::manager() const
@@ -36,15 +68,36 @@ BluezQt::Manager *ObexAgent::manager() const
     return m_manager;
 }
 
-bool ObexAgent::shouldAutoAcceptTransfer(const QString &address) const
+ReceivedFilesIndex *ObexAgent::receivedFilesIndex() const
+{
+    return m_receivedFilesIndex;
+}
+
+QThread *ObexAgent::hashThread()
 {
-    if (!m_transferTimes.contains(address)) {
-        return false;
+    // Only started once a file is received in place
+    if (!m_hashThread.isRunning()) {
+        m_hashThread.setObjectName(QStringLiteral("FileHasher"));
+        m_hashThread.start(QThread::LowPriority);
     }
+    return &m_hashThread;
+}
+
+TransferThrottle *ObexAgent::transferThrottle() const
+{
+    return m_throttle;
+}
 
-    // Auto-accept transfers from the same device within 2 seconds from last finished transfer
-    const int timeout = 2;
-    return m_transferTimes.value(address).secsTo(QDateTime::currentDateTime()) < timeout;
+DeviceIndex *ObexAgent::deviceIndex() const
+{
+    return m_deviceIndex;
+}
+
+bool ObexAgent::shouldAutoAcceptTransfer(const QString &address) const
+{
+    // Auto-accept transfers from the same device while its batch is still open
+    ReceiveBatchJob *batch = m_batches.value(address);
+    return batch && batch->isAccepted();
 }
 
 QDBusObjectPath ObexAgent::objectPath() const
@@ -56,27 +109,223 @@ void ObexAgent::authorizePush(BluezQt::ObexTransferPtr transfer, BluezQt::ObexSe
 {
     qCDebug(BLUEDAEMON) << "ObexAgent-AuthorizePush";
 
-    FileReceiverSettings::self()->load();
+    Push push;
+    push.address = session->destination();
+    push.size = transfer->size();
+    push.transfer = transfer;
+    push.session = session;
+    push.request = request;
+    push.time = QDateTime::currentDateTime();
+
+    // Settings are loaded once per batch
+    if (!m_batches.contains(push.address)) {
+        FileReceiverSettings::self()->load();
+    }
+
     if (!FileReceiverSettings::self()->enabled()) {
         qCDebug(BLUEDAEMON) << "File receiver disabled, rejecting incoming file";
         request.reject();
         return;
     }
 
-    ReceiveFileJob *job = new ReceiveFileJob(request, transfer, session, this);
-    connect(job, &ReceiveFileJob::finished, this, &ObexAgent::receiveFileJobFinished);
-    job->start();
+    const QString &error = admissionError(push);
+    if (!error.isEmpty()) {
+        qCWarning(BLUEDAEMON) << "Rejecting" << transfer->name() << "from" << push.address << ":" << error;
+        request.reject();
+        return;
+    }
+
+    // Charged already now so that queued pushes count as well, refunded
+    // if the push doesn't complete
+    DeviceUsage &usage = m_deviceUsage[push.address];
+    usage.bytes += push.size;
+
+    if (m_queue.isEmpty() && canStart(push.address)) {
+        startPush(push);
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Queueing" << transfer->name() << "from" << push.address;
+
+    m_queue.append(push);
+    m_queueTimer.start();
+    Q_EMIT queueChanged();
+}
+
+int ObexAgent::activeTransfers() const
+{
+    return m_activePushes.count();
+}
+
+int ObexAgent::queuedTransfers() const
+{
+    return m_queue.count();
+}
+
+QStringList ObexAgent::queuedDevices() const
+{
+    QStringList addresses;
+
+    Q_FOREACH (const Push &push, m_queue) {
+        addresses.append(push.address);
+    }
+
+    return addresses;
 }
 
 void ObexAgent::receiveFileJobFinished(KJob *job)
 {
-    Q_ASSERT(qobject_cast<ReceiveFileJob*>(job));
-    ReceiveFileJob *j = static_cast<ReceiveFileJob*>(job);
+    const Push push = m_activePushes.take(job);
+
+    // Rejected, failed and cancelled pushes don't count to the quota
+    if (job->error()) {
+        refundUsage(push);
+    }
+
+    ReceiveFileJob *receiveJob = static_cast<ReceiveFileJob*>(job);
+    if (receiveJob->isAccepted()) {
+        TransferHistory::Entry entry;
+        entry.direction = TransferHistory::Received;
+        entry.address = push.address;
+        entry.deviceName = receiveJob->deviceName();
+        entry.fileName = receiveJob->fileName();
+        entry.url = receiveJob->targetUrl();
+        entry.size = push.size;
+        entry.time = receiveJob->startTime().isValid() ? receiveJob->startTime() : push.time;
+        entry.duration = entry.time.msecsTo(QDateTime::currentDateTime());
+        entry.success = !job->error();
+        entry.errorText = job->errorText();
+        m_history->add(entry);
+    }
+
+    if (--m_activePerDevice[push.address] <= 0) {
+        m_activePerDevice.remove(push.address);
+    }
 
-    if (j->error()) {
-        m_transferTimes.remove(j->deviceAddress());
+    startQueuedPushes();
+    Q_EMIT queueChanged();
+}
+
+void ObexAgent::expireQueuedPushes()
+{
+    const QDateTime &now = QDateTime::currentDateTime();
+
+    // Reject pushes before obexd gives up on them
+    for (int i = 0; i < m_queue.count(); ++i) {
+        if (m_queue.at(i).time.secsTo(now) >= s_queueTimeout) {
+            const Push push = m_queue.takeAt(i--);
+            qCWarning(BLUEDAEMON) << "Rejecting" << push.transfer->name() << "from" << push.address << ": waited too long";
+            push.request.reject();
+            refundUsage(push);
+            Q_EMIT queueChanged();
+        }
+    }
+
+    if (m_queue.isEmpty()) {
+        m_queueTimer.stop();
+    }
+}
+
+QString ObexAgent::admissionError(const Push &push)
+{
+    const quint64 MiB = 1024 * 1024;
+
+    DeviceUsage &usage = m_deviceUsage[push.address];
+    if (usage.date != QDate::currentDate()) {
+        usage.date = QDate::currentDate();
+        usage.bytes = 0;
+    }
+
+    const int quota = FileReceiverSettings::self()->deviceQuota();
+    if (quota > 0 && usage.bytes + push.size > quint64(quota) * MiB) {
+        return QStringLiteral("device quota exceeded");
+    }
+
+    const QUrl &saveUrl = FileReceiverSettings::self()->saveUrl();
+    const QString &path = saveUrl.isLocalFile() ? saveUrl.toLocalFile()
+                                                : QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+
+    // Space for transfers that are still running or queued is already taken
+    quint64 reserved = push.size;
+    Q_FOREACH (const Push &p, m_activePushes) {
+        reserved += p.size;
+    }
+    Q_FOREACH (const Push &p, m_queue) {
+        reserved += p.size;
+    }
+
+    const QStorageInfo storage(path);
+    const quint64 minFree = quint64(qMax(0, FileReceiverSettings::self()->minFreeSpace())) * MiB;
+
+    if (storage.isValid() && quint64(storage.bytesAvailable()) < reserved + minFree) {
+        return QStringLiteral("not enough free space");
+    }
+
+    return QString();
+}
+
+void ObexAgent::refundUsage(const Push &push)
+{
+    auto it = m_deviceUsage.find(push.address);
+
+    // Usage was reset in the meantime, the push isn't counted anymore
+    if (it == m_deviceUsage.end() || it->date != push.time.date()) {
         return;
     }
 
-    m_transferTimes[j->deviceAddress()] = QDateTime::currentDateTime();
+    it->bytes -= qMin(it->bytes, push.size);
+}
+
+bool ObexAgent::canStart(const QString &address) const
+{
+    // Receive one file at a time while audio is playing
+    const int maxActive = m_throttle->isActive() ? 1 : qMax(1, FileReceiverSettings::self()->maxActiveTransfers());
+    const int maxPerDevice = qMax(1, FileReceiverSettings::self()->maxActiveTransfersPerDevice());
+
+    return m_activePushes.count() < maxActive && m_activePerDevice.value(address) < maxPerDevice;
+}
+
+void ObexAgent::startPush(const Push &push)
+{
+    ReceiveBatchJob *batch = m_batches.value(push.address);
+
+    if (!batch) {
+        batch = new ReceiveBatchJob(push.address, this);
+        connect(batch, &ReceiveBatchJob::finished, this, &ObexAgent::receiveBatchJobFinished);
+        m_batches.insert(push.address, batch);
+        batch->start();
+    }
+
+    ReceiveFileJob *job = new ReceiveFileJob(push.request, push.transfer, push.session, this);
+    connect(job, &ReceiveFileJob::finished, this, &ObexAgent::receiveFileJobFinished);
+
+    m_activePushes.insert(job, push);
+    m_activePerDevice[push.address]++;
+
+    batch->addFile(job);
+    job->start();
+}
+
+void ObexAgent::startQueuedPushes()
+{
+    // Start pushes in order, skipping devices that are at their limit
+    for (int i = 0; i < m_queue.count(); ++i) {
+        if (canStart(m_queue.at(i).address)) {
+            startPush(m_queue.takeAt(i--));
+        }
+    }
+
+    if (m_queue.isEmpty()) {
+        m_queueTimer.stop();
+    }
+}
+
+void ObexAgent::receiveBatchJobFinished(KJob *job)
+{
+    Q_ASSERT(qobject_cast<ReceiveBatchJob*>(job));
+    ReceiveBatchJob *batch = static_cast<ReceiveBatchJob*>(job);
+
+    if (m_batches.value(batch->deviceAddress()) == batch) {
+        m_batches.remove(batch->deviceAddress());
+    }
 }
@@ -21,10 +21,23 @@
 #define OBEXAGENT_H
 
 #include <BluezQt/ObexAgent>
+#include <BluezQt/Request>
+
 #include <QHash>
+#include <QDate>
+#include <QTimer>
+#include <QThread>
+#include <QDateTime>
+#include <QStringList>
+
 class KJob;
 
 class BlueDevilDaemon;
+class ReceiveBatchJob;
+class ReceivedFilesIndex;
+class TransferHistory;
+class TransferThrottle;
+class DeviceIndex;
 
 class ObexAgent : public BluezQt::ObexAgent
 {
@@ -33,19 +46,70 @@ class ObexAgent : public BluezQt::ObexAgent
 public:
     explicit ObexAgent(BlueDevilDaemon *daemon);
 
+    ~ObexAgent() override;
+
     BluezQt::Manager *manager() const;
+    ReceivedFilesIndex *receivedFilesIndex() const;
+    // Thread for hashing received files, see FileHasher
+    QThread *hashThread();
+    TransferThrottle *transferThrottle() const;
+    DeviceIndex *deviceIndex() const;
 
     bool shouldAutoAcceptTransfer(const QString &address) const;
 
     QDBusObjectPath objectPath() const override;
     void authorizePush(BluezQt::ObexTransferPtr transfer, BluezQt::ObexSessionPtr session, const BluezQt::Request<QString> &request) override;
 
+    int activeTransfers() const;
+    int queuedTransfers() const;
+
+    // Addresses of devices with queued transfers, in the order they will be started
+    QStringList queuedDevices() const;
+
+Q_SIGNALS:
+    void queueChanged();
+
 private Q_SLOTS:
     void receiveFileJobFinished(KJob *job);
+    void receiveBatchJobFinished(KJob *job);
+    void expireQueuedPushes();
 
 private:
+    struct Push
+    {
+        QString address;
+        quint64 size = 0;
+        BluezQt::ObexTransferPtr transfer;
+        BluezQt::ObexSessionPtr session;
+        BluezQt::Request<QString> request;
+        QDateTime time;
+    };
+
+    struct DeviceUsage
+    {
+        QDate date;
+        quint64 bytes = 0;
+    };
+
+    QString admissionError(const Push &push);
+    void refundUsage(const Push &push);
+    bool canStart(const QString &address) const;
+    void startPush(const Push &push);
+    void startQueuedPushes();
+
     BluezQt::Manager *m_manager;
-    QHash<QString, QDateTime> m_transferTimes;
+    ReceivedFilesIndex *m_receivedFilesIndex;
+    TransferHistory *m_history;
+    TransferThrottle *m_throttle;
+    DeviceIndex *m_deviceIndex;
+    QHash<QString, ReceiveBatchJob*> m_batches;
+
+    QList<Push> m_queue;
+    QHash<KJob*, Push> m_activePushes;
+    QHash<QString, int> m_activePerDevice;
+    QHash<QString, DeviceUsage> m_deviceUsage;
+    QTimer m_queueTimer;
+    QThread m_hashThread;
 };
 
 #endif // OBEXAGENT_H
@@ -20,6 +20,7 @@
 #include "obexftp.h"
 #include "debug_p.h"
 #include "bluedevildaemon.h"
+#include "deviceindex.h"
 
 #include <QDBusConnection>
 #include <QDBusObjectPath>
@@ -29,6 +30,7 @@
 #include <KLocalizedString>
 
 #include <BluezQt/Device>
+#include <BluezQt/Manager>
 #include <BluezQt/ObexManager>
 #include <BluezQt/InitObexManagerJob>
 #include <BluezQt/ObexFileTransfer>
@@ -49,10 +51,8 @@ bool ObexFtp::isOnline()
 
 QString ObexFtp::preferredTarget(const QString &address)
 {
-    BluezQt::DevicePtr device = m_daemon->manager()->deviceForAddress(address);
-
     // Prefer pcsuite target on S60 devices
-    if (device && device->uuids().contains(QStringLiteral("00005005-0000-1000-8000-0002EE000001"))) {
+    if (m_daemon->deviceIndex()->services(address) & BluetoothServices::PcSuite) {
         return QStringLiteral("pcsuite");
     }
     return QStringLiteral("ftp");
@@ -109,6 +109,18 @@ bool ObexFtp::cancelTransfer(const QString &transfer, const QDBusMessage &msg)
     return false;
 }
 
+bool ObexFtp::isConnected(const QString &address)
+{
+    // The session goes away when obexd loses the transport, the device may
+    // still be connected for a moment after that
+    if (!m_sessionMap.contains(address)) {
+        return false;
+    }
+
+    BluezQt::DevicePtr device = m_daemon->manager()->deviceForAddress(address);
+    return device && device->isConnected();
+}
+
 void ObexFtp::createSessionFinished(BluezQt::PendingCall *call)
 {
     QString path;
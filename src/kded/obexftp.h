@@ -42,6 +42,7 @@ public:
     Q_SCRIPTABLE QString preferredTarget(const QString &address);
     Q_SCRIPTABLE QString session(const QString &address, const QString &target, const QDBusMessage &msg);
     Q_SCRIPTABLE bool cancelTransfer(const QString &transfer, const QDBusMessage &msg);
+    Q_SCRIPTABLE bool isConnected(const QString &address);
 
 private Q_SLOTS:
     void createSessionFinished(BluezQt::PendingCall *call);
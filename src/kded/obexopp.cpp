@@ -0,0 +1,223 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "obexopp.h"
+#include "debug_p.h"
+#include "bluedevildaemon.h"
+
+#include <QTimer>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QDBusPendingCallWatcher>
+
+#include <BluezQt/ObexManager>
+#include <BluezQt/ObexSession>
+#include <BluezQt/PendingCall>
+
+// How long an unused session is kept open (in msec)
+static const int s_idleTimeout = 30 * 1000;
+
+ObexOpp::ObexOpp(BlueDevilDaemon *daemon)
+    : QDBusAbstractAdaptor(daemon)
+    , m_daemon(daemon)
+{
+    m_serviceWatcher = new QDBusServiceWatcher(this);
+    m_serviceWatcher->setConnection(QDBusConnection::sessionBus());
+    m_serviceWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &ObexOpp::serviceUnregistered);
+    connect(m_daemon->obexManager(), &BluezQt::ObexManager::sessionRemoved, this, &ObexOpp::sessionRemoved);
+}
+
+bool ObexOpp::isOnline()
+{
+    return m_daemon->obexManager()->isOperational();
+}
+
+QString ObexOpp::session(const QString &address, const QDBusMessage &msg)
+{
+    if (!m_daemon->obexManager()->isOperational()) {
+        return QString();
+    }
+
+    if (m_sessions.contains(address)) {
+        qCDebug(BLUEDAEMON) << "Reusing opp session for" << address;
+        addUser(address, msg.service());
+        return m_sessions.value(address).path;
+    }
+
+    // At this point we always want delayed reply
+    msg.setDelayedReply(true);
+
+    if (m_pendingSessions.contains(address)) {
+        m_pendingSessions[address].append(msg);
+        return QString();
+    }
+
+    qCDebug(BLUEDAEMON) << "Creating opp session for" << address;
+
+    m_pendingSessions.insert(address, {msg});
+
+    QVariantMap args;
+    args[QStringLiteral("Target")] = QStringLiteral("opp");
+
+    BluezQt::PendingCall *call = m_daemon->obexManager()->createSession(address, args);
+    call->setUserData(address);
+    connect(call, &BluezQt::PendingCall::finished, this, &ObexOpp::createSessionFinished);
+
+    return QString();
+}
+
+void ObexOpp::releaseSession(const QString &address, const QDBusMessage &msg)
+{
+    removeUser(address, msg.service());
+}
+
+bool ObexOpp::cancelTransfer(const QString &transfer, const QDBusMessage &msg)
+{
+    // Only the owner of the session can cancel its transfers
+    msg.setDelayedReply(true);
+
+    QDBusMessage call = QDBusMessage::createMethodCall(QStringLiteral("org.bluez.obex"),
+                            transfer,
+                            QStringLiteral("org.bluez.obex.Transfer1"),
+                            QStringLiteral("Cancel"));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call));
+    watcher->setProperty("ObexOppDaemon-msg", QVariant::fromValue(msg));
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, &ObexOpp::cancelTransferFinished);
+
+    return false;
+}
+
+void ObexOpp::createSessionFinished(BluezQt::PendingCall *call)
+{
+    QString path;
+
+    if (call->error()) {
+        qCWarning(BLUEDAEMON) << "Error creating opp session" << call->errorText();
+    } else {
+        path = call->value().value<QDBusObjectPath>().path();
+        qCDebug(BLUEDAEMON) << "Created opp session" << path;
+    }
+
+    const QString &address = call->userData().toString();
+    const QList<QDBusMessage> messages = m_pendingSessions.take(address);
+
+    if (!call->error()) {
+        Session session;
+        session.path = path;
+        session.idleTimer = new QTimer(this);
+        session.idleTimer->setSingleShot(true);
+        session.idleTimer->setInterval(s_idleTimeout);
+        connect(session.idleTimer, &QTimer::timeout, this, [this, address]() {
+            closeSession(address);
+        });
+        m_sessions.insert(address, session);
+
+        Q_FOREACH (const QDBusMessage &msg, messages) {
+            addUser(address, msg.service());
+        }
+    }
+
+    // Send reply (empty session path in case of error)
+    Q_FOREACH (const QDBusMessage &msg, messages) {
+        QDBusMessage reply = msg.createReply(path);
+        QDBusConnection::sessionBus().send(reply);
+    }
+}
+
+void ObexOpp::cancelTransferFinished(QDBusPendingCallWatcher *watcher)
+{
+    const QDBusPendingReply<> &reply = *watcher;
+    QDBusMessage msg = watcher->property("ObexOppDaemon-msg").value<QDBusMessage>();
+
+    bool success = !reply.isError();
+    QDBusConnection::sessionBus().send(msg.createReply(QVariant(success)));
+
+    watcher->deleteLater();
+}
+
+void ObexOpp::sessionRemoved(BluezQt::ObexSessionPtr session)
+{
+    const QString &path = session->objectPath().path();
+
+    QHash<QString, Session>::iterator it = m_sessions.begin();
+    while (it != m_sessions.end()) {
+        if (it.value().path == path) {
+            qCDebug(BLUEDAEMON) << "Removed opp session" << path;
+            delete it.value().idleTimer;
+            it = m_sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ObexOpp::serviceUnregistered(const QString &service)
+{
+    m_serviceWatcher->removeWatchedService(service);
+
+    Q_FOREACH (const QString &address, m_sessions.keys()) {
+        while (m_sessions.contains(address) && m_sessions.value(address).users.contains(service)) {
+            removeUser(address, service);
+        }
+    }
+}
+
+void ObexOpp::addUser(const QString &address, const QString &service)
+{
+    Session &session = m_sessions[address];
+    session.users.append(service);
+    session.idleTimer->stop();
+
+    if (!m_serviceWatcher->watchedServices().contains(service)) {
+        m_serviceWatcher->addWatchedService(service);
+    }
+}
+
+void ObexOpp::removeUser(const QString &address, const QString &service)
+{
+    if (!m_sessions.contains(address)) {
+        return;
+    }
+
+    Session &session = m_sessions[address];
+    session.users.removeOne(service);
+
+    if (session.users.isEmpty()) {
+        session.idleTimer->start();
+    }
+}
+
+void ObexOpp::closeSession(const QString &address)
+{
+    if (!m_sessions.contains(address)) {
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Closing idle opp session for" << address;
+
+    const Session session = m_sessions.take(address);
+    session.idleTimer->deleteLater();
+
+    m_daemon->obexManager()->removeSession(QDBusObjectPath(session.path));
+}
@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef OBEXOPP_H
+#define OBEXOPP_H
+
+#include <QHash>
+#include <QStringList>
+#include <QDBusMessage>
+#include <QDBusAbstractAdaptor>
+
+#include <BluezQt/Manager>
+
+class QTimer;
+class QDBusServiceWatcher;
+class QDBusPendingCallWatcher;
+
+class BlueDevilDaemon;
+
+/**
+ * Keeps Object Push sessions open between sends.
+ *
+ * Senders get a session with session() and give it back with releaseSession().
+ * A session without users is removed after a short idle timeout, so back-to-back
+ * sends to the same device don't have to connect again. Sessions of clients that
+ * quit without releasing them are released automatically.
+ */
+class Q_DECL_EXPORT ObexOpp : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.BlueDevil.ObexOpp")
+
+public:
+    explicit ObexOpp(BlueDevilDaemon *daemon);
+
+    Q_SCRIPTABLE bool isOnline();
+    Q_SCRIPTABLE QString session(const QString &address, const QDBusMessage &msg);
+    Q_SCRIPTABLE void releaseSession(const QString &address, const QDBusMessage &msg);
+    Q_SCRIPTABLE bool cancelTransfer(const QString &transfer, const QDBusMessage &msg);
+
+private Q_SLOTS:
+    void createSessionFinished(BluezQt::PendingCall *call);
+    void cancelTransferFinished(QDBusPendingCallWatcher *watcher);
+    void sessionRemoved(BluezQt::ObexSessionPtr session);
+    void serviceUnregistered(const QString &service);
+
+private:
+    struct Session
+    {
+        QString path;
+        QStringList users;
+        QTimer *idleTimer = nullptr;
+    };
+
+    void addUser(const QString &address, const QString &service);
+    void removeUser(const QString &address, const QString &service);
+    void closeSession(const QString &address);
+
+    BlueDevilDaemon *m_daemon;
+    QDBusServiceWatcher *m_serviceWatcher;
+    QHash<QString, Session> m_sessions;
+    QHash<QString, QList<QDBusMessage> > m_pendingSessions;
+};
+
+#endif // OBEXOPP_H
@@ -0,0 +1,302 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "obexpush.h"
+#include "pushfilesjob.h"
+#include "bluedevildaemon.h"
+#include "deviceindex.h"
+#include "debug_p.h"
+
+#include <QTimer>
+#include <QFileInfo>
+
+#include <KConfigGroup>
+#include <KNotification>
+#include <KLocalizedString>
+#include <KIO/JobTracker>
+#include <KJobTrackerInterface>
+
+#include <BluezQt/Device>
+#include <BluezQt/ObexManager>
+
+#include <algorithm>
+
+// Retries start after 15 seconds and are doubled up to 30 minutes
+static const int s_retryInterval = 15;
+static const int s_maxRetryInterval = 30 * 60;
+
+// Failed attempts before a file is dropped from the queue
+static const int s_maxFileAttempts = 5;
+
+ObexPush::ObexPush(BlueDevilDaemon *daemon)
+    : QDBusAbstractAdaptor(daemon)
+    , m_daemon(daemon)
+    , m_config(KSharedConfig::openConfig(QStringLiteral("bluedevilpushqueuerc"), KConfig::SimpleConfig))
+{
+    connect(m_daemon->obexManager(), &BluezQt::ObexManager::operationalChanged, this, &ObexPush::obexOperationalChanged);
+    connect(m_daemon->manager(), &BluezQt::Manager::deviceChanged, this, &ObexPush::deviceChanged);
+
+    loadQueues();
+}
+
+bool ObexPush::enqueue(const QString &address, const QStringList &files)
+{
+    Queue &q = queue(address);
+
+    Q_FOREACH (const QString &filePath, files) {
+        const QFileInfo info(filePath);
+        if (!info.isFile() || !info.isReadable()) {
+            qCWarning(BLUEDAEMON) << "Not queueing unreadable file" << filePath;
+            continue;
+        }
+        if (!q.files.contains(info.absoluteFilePath())) {
+            q.files.append(info.absoluteFilePath());
+        }
+    }
+
+    if (q.files.isEmpty()) {
+        removeQueue(address);
+        return false;
+    }
+
+    // Send small files first, so that most files get through a flaky connection
+    std::stable_sort(q.files.begin(), q.files.end(), [](const QString &a, const QString &b) {
+        return QFileInfo(a).size() < QFileInfo(b).size();
+    });
+
+    saveQueue(address);
+
+    // New files are picked up once the running job finishes
+    if (!q.job) {
+        q.attempts = 0;
+        startQueue(address);
+    }
+
+    return true;
+}
+
+QStringList ObexPush::pendingFiles(const QString &address)
+{
+    return m_queues.value(address).files;
+}
+
+QStringList ObexPush::pendingDevices()
+{
+    return m_queues.keys();
+}
+
+void ObexPush::cancel(const QString &address)
+{
+    if (!m_queues.contains(address)) {
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Cancelling queued files for" << address;
+
+    PushFilesJob *job = m_queues.value(address).job;
+    removeQueue(address);
+
+    if (job) {
+        job->kill();
+    }
+}
+
+void ObexPush::obexOperationalChanged(bool operational)
+{
+    if (!operational) {
+        return;
+    }
+
+    Q_FOREACH (const QString &address, m_queues.keys()) {
+        startQueue(address);
+    }
+}
+
+void ObexPush::deviceChanged(BluezQt::DevicePtr device)
+{
+    if (!device->isConnected() || !m_queues.contains(device->address())) {
+        return;
+    }
+
+    // Device is back in range, don't wait for the backoff
+    const Queue &q = m_queues.value(device->address());
+    if (!q.job && q.retryTimer->isActive()) {
+        qCDebug(BLUEDAEMON) << "Device connected, retrying queued files for" << device->address();
+        startQueue(device->address());
+    }
+}
+
+void ObexPush::fileFinished(const QString &filePath)
+{
+    PushFilesJob *job = static_cast<PushFilesJob*>(sender());
+
+    if (!m_queues.contains(job->address())) {
+        return;
+    }
+
+    Queue &q = m_queues[job->address()];
+    q.files.removeOne(filePath);
+    q.fileAttempts.remove(filePath);
+    q.attempts = 0;
+    saveQueue(job->address());
+}
+
+void ObexPush::pushFilesJobFinished(KJob *job)
+{
+    PushFilesJob *pushJob = static_cast<PushFilesJob*>(job);
+    const QString address = pushJob->address();
+
+    if (!m_queues.contains(address)) {
+        return;
+    }
+
+    Queue &q = m_queues[address];
+    q.job = nullptr;
+
+    // Cancelled by user from the job tracker
+    if (job->error() == KJob::KilledJobError) {
+        removeQueue(address);
+        return;
+    }
+
+    // Don't retry a file forever, the device may refuse it every time
+    const QString failedFile = pushJob->failedFile();
+    bool dropped = false;
+
+    if (job->error() && !failedFile.isEmpty()) {
+        const int attempts = ++q.fileAttempts[failedFile];
+        if (pushJob->isPermanentError() || attempts >= s_maxFileAttempts) {
+            dropFile(address, failedFile, job->errorText());
+            dropped = true;
+        }
+    }
+
+    if (q.files.isEmpty()) {
+        qCDebug(BLUEDAEMON) << "All queued files sent to" << address;
+        removeQueue(address);
+        return;
+    }
+
+    if (job->error() && !dropped) {
+        scheduleRetry(address);
+    } else {
+        // Files were queued while the job was running, or the failed file
+        // was dropped and the others may still go through
+        startQueue(address);
+    }
+}
+
+ObexPush::Queue &ObexPush::queue(const QString &address)
+{
+    Queue &q = m_queues[address];
+
+    if (!q.retryTimer) {
+        q.retryTimer = new QTimer(this);
+        q.retryTimer->setSingleShot(true);
+        connect(q.retryTimer, &QTimer::timeout, this, [this, address]() {
+            startQueue(address);
+        });
+    }
+
+    return q;
+}
+
+void ObexPush::startQueue(const QString &address)
+{
+    Queue &q = m_queues[address];
+
+    if (q.job || !m_daemon->obexManager()->isOperational()) {
+        return;
+    }
+
+    q.retryTimer->stop();
+
+    BluezQt::DevicePtr device = m_daemon->deviceIndex()->device(address);
+    const QString name = device ? device->name() : address;
+
+    q.job = new PushFilesJob(address, name, q.files, m_daemon->obexManager(), this);
+    q.job->setTransferHistory(m_daemon->transferHistory());
+    q.job->setTransferThrottle(m_daemon->transferThrottle());
+    connect(q.job, &PushFilesJob::fileFinished, this, &ObexPush::fileFinished);
+    connect(q.job, &PushFilesJob::finished, this, &ObexPush::pushFilesJobFinished);
+
+    KIO::getJobTracker()->registerJob(q.job);
+    q.job->start();
+}
+
+void ObexPush::scheduleRetry(const QString &address)
+{
+    Queue &q = m_queues[address];
+
+    const int interval = qMin(s_retryInterval << qMin(q.attempts, 16), s_maxRetryInterval);
+    q.attempts++;
+
+    qCDebug(BLUEDAEMON) << "Retrying" << q.files.count() << "queued files for" << address << "in" << interval << "seconds";
+
+    q.retryTimer->start(interval * 1000);
+}
+
+void ObexPush::removeQueue(const QString &address)
+{
+    const Queue q = m_queues.take(address);
+    delete q.retryTimer;
+
+    m_config->group("Queue").deleteEntry(address);
+    m_config->sync();
+}
+
+void ObexPush::dropFile(const QString &address, const QString &filePath, const QString &errorText)
+{
+    Queue &q = m_queues[address];
+    q.files.removeOne(filePath);
+    q.fileAttempts.remove(filePath);
+    saveQueue(address);
+
+    qCWarning(BLUEDAEMON) << "Dropping queued file" << filePath << "for" << address << errorText;
+
+    BluezQt::DevicePtr device = m_daemon->deviceIndex()->device(address);
+    const QString name = device ? device->name() : address;
+
+    KNotification *notification = new KNotification(QStringLiteral("SendFailed"),
+                                                    KNotification::CloseOnTimeout, this);
+    notification->setComponentName(QStringLiteral("bluedevil"));
+    notification->setTitle(i18n("Sending file failed"));
+    notification->setText(i18nc("File name, device name, error", "%1 could not be sent to %2: %3",
+                                QFileInfo(filePath).fileName(), name.toHtmlEscaped(), errorText));
+    notification->sendEvent();
+}
+
+void ObexPush::loadQueues()
+{
+    const KConfigGroup group = m_config->group("Queue");
+
+    Q_FOREACH (const QString &address, group.keyList()) {
+        queue(address).files = group.readEntry<QStringList>(address, QStringList());
+        qCDebug(BLUEDAEMON) << "Restored" << m_queues.value(address).files.count() << "queued files for" << address;
+    }
+
+    obexOperationalChanged(m_daemon->obexManager()->isOperational());
+}
+
+void ObexPush::saveQueue(const QString &address)
+{
+    KConfigGroup group = m_config->group("Queue");
+    group.writeEntry<QStringList>(address, m_queues.value(address).files);
+    m_config->sync();
+}
@@ -0,0 +1,91 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef OBEXPUSH_H
+#define OBEXPUSH_H
+
+#include <QHash>
+#include <QStringList>
+#include <QDBusAbstractAdaptor>
+
+#include <KSharedConfig>
+
+#include <BluezQt/Types>
+
+class QTimer;
+
+class KJob;
+
+class BlueDevilDaemon;
+class PushFilesJob;
+
+/**
+ * Queue of files to be sent to devices, exported as org.kde.BlueDevil.Push.
+ *
+ * Queued files are saved to disk and survive kded restarts. Smaller files are
+ * sent first. When sending fails, the remaining files stay queued and are
+ * retried with exponential backoff, or as soon as the device connects again.
+ * A file that obexd refuses, or that failed too often, is dropped and the
+ * user is notified.
+ */
+class Q_DECL_EXPORT ObexPush : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.BlueDevil.Push")
+
+public:
+    explicit ObexPush(BlueDevilDaemon *daemon);
+
+    Q_SCRIPTABLE bool enqueue(const QString &address, const QStringList &files);
+    Q_SCRIPTABLE QStringList pendingFiles(const QString &address);
+    Q_SCRIPTABLE QStringList pendingDevices();
+    Q_SCRIPTABLE void cancel(const QString &address);
+
+private Q_SLOTS:
+    void obexOperationalChanged(bool operational);
+    void deviceChanged(BluezQt::DevicePtr device);
+    void fileFinished(const QString &filePath);
+    void pushFilesJobFinished(KJob *job);
+
+private:
+    struct Queue
+    {
+        QStringList files;
+        int attempts = 0;
+        // Failed attempts by file, not saved
+        QHash<QString, int> fileAttempts;
+        QTimer *retryTimer = nullptr;
+        PushFilesJob *job = nullptr;
+    };
+
+    Queue &queue(const QString &address);
+    void startQueue(const QString &address);
+    void scheduleRetry(const QString &address);
+    void removeQueue(const QString &address);
+    void dropFile(const QString &address, const QString &filePath, const QString &errorText);
+
+    void loadQueues();
+    void saveQueue(const QString &address);
+
+    BlueDevilDaemon *m_daemon;
+    KSharedConfig::Ptr m_config;
+    QHash<QString, Queue> m_queues;
+};
+
+#endif // OBEXPUSH_H
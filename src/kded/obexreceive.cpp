@@ -0,0 +1,46 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "obexreceive.h"
+#include "obexagent.h"
+#include "bluedevildaemon.h"
+
+ObexReceive::ObexReceive(BlueDevilDaemon *daemon)
+    : QDBusAbstractAdaptor(daemon)
+    , m_agent(daemon->obexAgent())
+{
+    connect(m_agent, &ObexAgent::queueChanged, this, [this]() {
+        Q_EMIT queueChanged(m_agent->activeTransfers(), m_agent->queuedTransfers());
+    });
+}
+
+int ObexReceive::activeTransfers()
+{
+    return m_agent->activeTransfers();
+}
+
+int ObexReceive::queuedTransfers()
+{
+    return m_agent->queuedTransfers();
+}
+
+QStringList ObexReceive::queuedDevices()
+{
+    return m_agent->queuedDevices();
+}
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef OBEXRECEIVE_H
+#define OBEXRECEIVE_H
+
+#include <QStringList>
+#include <QDBusAbstractAdaptor>
+
+class BlueDevilDaemon;
+class ObexAgent;
+
+/**
+ * Exports state of incoming transfers as org.kde.BlueDevil.Receive.
+ */
+class Q_DECL_EXPORT ObexReceive : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.BlueDevil.Receive")
+
+public:
+    explicit ObexReceive(BlueDevilDaemon *daemon);
+
+    Q_SCRIPTABLE int activeTransfers();
+    Q_SCRIPTABLE int queuedTransfers();
+    Q_SCRIPTABLE QStringList queuedDevices();
+
+Q_SIGNALS:
+    void queueChanged(int active, int queued);
+
+private:
+    ObexAgent *m_agent;
+};
+
+#endif // OBEXRECEIVE_H
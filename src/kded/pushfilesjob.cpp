@@ -0,0 +1,280 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "pushfilesjob.h"
+#include "debug_p.h"
+#include "transferthrottle.h"
+#include "../common/transferhistory.h"
+#include "../common/transfersize.h"
+
+#include <QFileInfo>
+
+#include <KLocalizedString>
+
+#include <BluezQt/PendingCall>
+#include <BluezQt/ObexManager>
+#include <BluezQt/ObexObjectPush>
+
+PushFilesJob::PushFilesJob(const QString &address, const QString &deviceName, const QStringList &files,
+                           BluezQt::ObexManager *manager, QObject *parent)
+    : KJob(parent)
+    , m_address(address)
+    , m_deviceName(deviceName)
+    , m_files(files)
+    , m_currentIndex(-1)
+    , m_permanentError(false)
+    , m_speedBytes(0)
+    , m_processed(0)
+    , m_history(nullptr)
+    , m_throttle(nullptr)
+    , m_manager(manager)
+    , m_objectPush(nullptr)
+{
+    quint64 total = 0;
+
+    Q_FOREACH (const QString &filePath, m_files) {
+        const quint64 size = QFileInfo(filePath).size();
+        m_sizes.append(size);
+        total += size;
+    }
+
+    setCapabilities(Killable);
+    setTotalAmount(Bytes, total);
+    setTotalAmount(Files, m_files.count());
+}
+
+PushFilesJob::~PushFilesJob()
+{
+    removeSession();
+}
+
+QString PushFilesJob::address() const
+{
+    return m_address;
+}
+
+QString PushFilesJob::failedFile() const
+{
+    return m_failedFile;
+}
+
+bool PushFilesJob::isPermanentError() const
+{
+    return m_permanentError;
+}
+
+void PushFilesJob::setTransferHistory(TransferHistory *history)
+{
+    m_history = history;
+}
+
+void PushFilesJob::setTransferThrottle(TransferThrottle *throttle)
+{
+    m_throttle = throttle;
+}
+
+void PushFilesJob::start()
+{
+    QMetaObject::invokeMethod(this, "doStart", Qt::QueuedConnection);
+}
+
+bool PushFilesJob::doKill()
+{
+    if (m_transfer) {
+        m_transfer->cancel();
+    }
+    removeSession();
+    return true;
+}
+
+void PushFilesJob::doStart()
+{
+    qCDebug(BLUEDAEMON) << "PushFilesJob-DoStart" << m_address << m_files.count() << "files";
+
+    Q_EMIT description(this, i18n("Sending file over Bluetooth"),
+                       QPair<QString, QString>(i18nc("File transfer origin", "From"),
+                                               i18np("%1 file", "%1 files", m_files.count())),
+                       QPair<QString, QString>(i18nc("File transfer destination", "To"), m_deviceName));
+
+    QVariantMap args;
+    args[QStringLiteral("Target")] = QStringLiteral("opp");
+
+    BluezQt::PendingCall *call = m_manager->createSession(m_address, args);
+    connect(call, &BluezQt::PendingCall::finished, this, &PushFilesJob::createSessionFinished);
+}
+
+void PushFilesJob::createSessionFinished(BluezQt::PendingCall *call)
+{
+    if (call->error()) {
+        qCWarning(BLUEDAEMON) << "Error creating session for" << m_address << call->errorText();
+        finishJob(call->errorText());
+        return;
+    }
+
+    m_session = call->value().value<QDBusObjectPath>();
+    m_objectPush = new BluezQt::ObexObjectPush(m_session, this);
+
+    sendNextFile();
+}
+
+void PushFilesJob::sendNextFile()
+{
+    m_transfer.clear();
+    m_speedBytes = 0;
+    m_currentIndex++;
+
+    setProcessedAmount(Files, m_currentIndex);
+
+    if (m_currentIndex >= m_files.count()) {
+        finishJob();
+        return;
+    }
+
+    const QString &filePath = m_files.at(m_currentIndex);
+
+    if (!QFileInfo::exists(filePath)) {
+        qCWarning(BLUEDAEMON) << "Dropping removed file" << filePath;
+        Q_EMIT fileFinished(filePath);
+        sendNextFile();
+        return;
+    }
+
+    Q_EMIT infoMessage(this, QFileInfo(filePath).fileName());
+
+    m_fileStartTime = QDateTime::currentDateTime();
+
+    BluezQt::PendingCall *call = m_objectPush->sendFile(filePath);
+    connect(call, &BluezQt::PendingCall::finished, this, &PushFilesJob::sendFileFinished);
+}
+
+void PushFilesJob::sendFileFinished(BluezQt::PendingCall *call)
+{
+    if (call->error()) {
+        qCWarning(BLUEDAEMON) << "Error sending file" << call->errorText();
+        m_failedFile = m_files.at(m_currentIndex);
+
+        switch (call->error()) {
+        case BluezQt::PendingCall::InvalidArguments:
+        case BluezQt::PendingCall::NotSupported:
+        case BluezQt::PendingCall::NotAuthorized:
+        case BluezQt::PendingCall::NotPermitted:
+        case BluezQt::PendingCall::Rejected:
+            m_permanentError = true;
+            break;
+        default:
+            break;
+        }
+
+        finishJob(call->errorText());
+        return;
+    }
+
+    m_transfer = call->value().value<BluezQt::ObexTransferPtr>();
+    connect(m_transfer.data(), &BluezQt::ObexTransfer::statusChanged, this, &PushFilesJob::statusChanged);
+    connect(m_transfer.data(), &BluezQt::ObexTransfer::transferredChanged, this, &PushFilesJob::transferredChanged);
+
+    if (m_throttle) {
+        m_throttle->addTransfer(m_transfer, m_session);
+    }
+}
+
+void PushFilesJob::statusChanged(BluezQt::ObexTransfer::Status status)
+{
+    switch (status) {
+    case BluezQt::ObexTransfer::Active:
+        m_time.start();
+        break;
+
+    case BluezQt::ObexTransfer::Complete:
+        m_processed += m_sizes.at(m_currentIndex);
+        setProcessedAmount(Bytes, m_processed);
+        addToHistory(QString());
+        Q_EMIT fileFinished(m_files.at(m_currentIndex));
+        sendNextFile();
+        break;
+
+    case BluezQt::ObexTransfer::Error:
+        // obexd doesn't tell whether the device rejected the file or the
+        // link dropped, ObexPush limits the attempts per file instead
+        m_failedFile = m_files.at(m_currentIndex);
+        addToHistory(i18n("Bluetooth transfer failed"));
+        finishJob(i18n("Bluetooth transfer failed"));
+        break;
+
+    default:
+        break;
+    }
+}
+
+void PushFilesJob::transferredChanged(quint64 transferred)
+{
+    // If at least 1 second has passed since last update
+    const qint64 msecsSinceLastTime = m_time.elapsed();
+    if (msecsSinceLastTime >= 1000) {
+        const quint64 speed = TransferSize::speed(transferred - m_speedBytes, msecsSinceLastTime);
+        emitSpeed(speed);
+
+        m_time.restart();
+        m_speedBytes = transferred;
+    }
+
+    setProcessedAmount(Bytes, m_processed + transferred);
+}
+
+void PushFilesJob::finishJob(const QString &errorText)
+{
+    removeSession();
+
+    if (!errorText.isEmpty()) {
+        setError(UserDefinedError);
+        setErrorText(errorText);
+    }
+
+    emitResult();
+}
+
+void PushFilesJob::removeSession()
+{
+    if (m_session.path().isEmpty()) {
+        return;
+    }
+
+    m_manager->removeSession(m_session);
+    m_session = QDBusObjectPath();
+}
+
+void PushFilesJob::addToHistory(const QString &errorText)
+{
+    if (!m_history) {
+        return;
+    }
+
+    TransferHistory::Entry entry;
+    entry.direction = TransferHistory::Sent;
+    entry.address = m_address;
+    entry.deviceName = m_deviceName;
+    entry.fileName = QFileInfo(m_files.at(m_currentIndex)).fileName();
+    entry.url = QUrl::fromLocalFile(m_files.at(m_currentIndex));
+    entry.size = m_sizes.at(m_currentIndex);
+    entry.time = m_fileStartTime;
+    entry.duration = m_fileStartTime.msecsTo(QDateTime::currentDateTime());
+    entry.success = errorText.isEmpty();
+    entry.errorText = errorText;
+    m_history->add(entry);
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef PUSHFILESJOB_H
+#define PUSHFILESJOB_H
+
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QVector>
+#include <QStringList>
+#include <QDBusObjectPath>
+
+#include <KJob>
+
+#include <BluezQt/ObexTransfer>
+
+namespace BluezQt
+{
+    class ObexObjectPush;
+}
+
+class TransferHistory;
+class TransferThrottle;
+
+/**
+ * Sends queued files to a device on behalf of ObexPush.
+ *
+ * fileFinished() is emitted for every file that was sent, or that can't be
+ * sent at all (eg. it was removed), so that it can be taken off the queue.
+ * The job fails on the first transfer error, the remaining files stay queued.
+ * failedFile() tells which file failed, if the failure was specific to it.
+ */
+class PushFilesJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    explicit PushFilesJob(const QString &address, const QString &deviceName, const QStringList &files,
+                          BluezQt::ObexManager *manager, QObject *parent = nullptr);
+    ~PushFilesJob() override;
+
+    QString address() const;
+
+    void setTransferHistory(TransferHistory *history);
+    void setTransferThrottle(TransferThrottle *throttle);
+
+    void start() override;
+
+    // File whose transfer failed, empty when the session couldn't be created
+    QString failedFile() const;
+
+    // Whether obexd refused the file itself, so sending it again can't succeed
+    bool isPermanentError() const;
+
+Q_SIGNALS:
+    void fileFinished(const QString &filePath);
+
+protected:
+    bool doKill() override;
+
+private Q_SLOTS:
+    void doStart();
+    void createSessionFinished(BluezQt::PendingCall *call);
+    void sendFileFinished(BluezQt::PendingCall *call);
+    void statusChanged(BluezQt::ObexTransfer::Status status);
+    void transferredChanged(quint64 transferred);
+
+private:
+    void sendNextFile();
+    void finishJob(const QString &errorText = QString());
+    void removeSession();
+    void addToHistory(const QString &errorText);
+
+    QString m_address;
+    QString m_deviceName;
+    QStringList m_files;
+    QVector<quint64> m_sizes;
+    int m_currentIndex;
+    QString m_failedFile;
+    bool m_permanentError;
+
+    QElapsedTimer m_time;
+    QDateTime m_fileStartTime;
+    TransferHistory *m_history;
+    TransferThrottle *m_throttle;
+    quint64 m_speedBytes;
+    quint64 m_processed;
+
+    QDBusObjectPath m_session;
+    BluezQt::ObexManager *m_manager;
+    BluezQt::ObexObjectPush *m_objectPush;
+    BluezQt::ObexTransferPtr m_transfer;
+};
+
+#endif // PUSHFILESJOB_H
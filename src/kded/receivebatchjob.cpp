@@ -0,0 +1,179 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "receivebatchjob.h"
+#include "receivefilejob.h"
+#include "debug_p.h"
+
+#include <KLocalizedString>
+#include <KIO/JobTracker>
+#include <KJobTrackerInterface>
+
+// Files pushed within this time after the last one belong to the same batch (in msec)
+static const int s_batchTimeout = 2000;
+
+ReceiveBatchJob::ReceiveBatchJob(const QString &address, QObject *parent)
+    : KJob(parent)
+    , m_address(address)
+    , m_accepted(false)
+    , m_fileCount(0)
+    , m_finishedCount(0)
+    , m_failedCount(0)
+    , m_finishedBytes(0)
+{
+    setCapabilities(Killable);
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(s_batchTimeout);
+    connect(&m_timer, &QTimer::timeout, this, &ReceiveBatchJob::finishBatch);
+}
+
+QString ReceiveBatchJob::deviceAddress() const
+{
+    return m_address;
+}
+
+bool ReceiveBatchJob::isAccepted() const
+{
+    return m_accepted;
+}
+
+void ReceiveBatchJob::addFile(ReceiveFileJob *job)
+{
+    m_timer.stop();
+    m_fileCount++;
+    m_activeFiles.insert(job, Progress());
+
+    connect(job, &ReceiveFileJob::accepted, this, &ReceiveBatchJob::fileAccepted);
+    connect(job, &KJob::totalAmount, this, &ReceiveBatchJob::fileAmountChanged);
+    connect(job, &KJob::processedAmount, this, &ReceiveBatchJob::fileAmountChanged);
+    connect(job, &KJob::finished, this, &ReceiveBatchJob::fileFinished);
+
+    connect(job, &KJob::description, this, [this](KJob *, const QString &title,
+                                                  const QPair<QString, QString> &field1,
+                                                  const QPair<QString, QString> &field2) {
+        Q_EMIT description(this, title, field1, field2);
+    });
+    connect(job, &KJob::speed, this, [this](KJob *, unsigned long value) {
+        emitSpeed(value);
+    });
+
+    updateAmounts();
+}
+
+void ReceiveBatchJob::start()
+{
+}
+
+bool ReceiveBatchJob::doKill()
+{
+    m_timer.stop();
+
+    Q_FOREACH (KJob *job, m_activeFiles.keys()) {
+        disconnect(job, nullptr, this, nullptr);
+        job->kill();
+    }
+    return true;
+}
+
+void ReceiveBatchJob::fileAccepted()
+{
+    if (m_accepted) {
+        return;
+    }
+
+    m_accepted = true;
+    KIO::getJobTracker()->registerJob(this);
+}
+
+void ReceiveBatchJob::fileAmountChanged(KJob *job, KJob::Unit unit, qulonglong amount)
+{
+    Q_UNUSED(amount)
+
+    if (unit != Bytes || !m_activeFiles.contains(job)) {
+        return;
+    }
+
+    Progress &progress = m_activeFiles[job];
+    progress.total = job->totalAmount(Bytes);
+    progress.processed = job->processedAmount(Bytes);
+
+    updateAmounts();
+}
+
+void ReceiveBatchJob::fileFinished(KJob *job)
+{
+    const Progress progress = m_activeFiles.take(job);
+
+    m_finishedCount++;
+    m_finishedBytes += job->error() ? progress.processed : progress.total;
+
+    // Rejected files are not failures
+    if (job->error() && !job->errorText().isEmpty()) {
+        m_failedCount++;
+        m_errorText = job->errorText();
+    }
+
+    updateAmounts();
+
+    if (!m_activeFiles.isEmpty()) {
+        return;
+    }
+
+    // Nothing was accepted, so there is nothing to keep the batch open for
+    if (!m_accepted) {
+        finishBatch();
+        return;
+    }
+
+    m_timer.start();
+}
+
+void ReceiveBatchJob::finishBatch()
+{
+    qCDebug(BLUEDAEMON) << "Received" << m_finishedCount << "files from" << m_address << "," << m_failedCount << "failed";
+
+    if (m_failedCount == 1 && m_fileCount == 1) {
+        setError(UserDefinedError);
+        setErrorText(m_errorText);
+    } else if (m_failedCount > 0) {
+        setError(UserDefinedError);
+        setErrorText(i18np("Receiving %1 file failed", "Receiving %1 files failed", m_failedCount));
+    } else if (!m_accepted) {
+        setError(UserDefinedError);
+    }
+
+    emitResult();
+}
+
+void ReceiveBatchJob::updateAmounts()
+{
+    qulonglong total = m_finishedBytes;
+    qulonglong processed = m_finishedBytes;
+
+    Q_FOREACH (const Progress &progress, m_activeFiles) {
+        total += progress.total;
+        processed += progress.processed;
+    }
+
+    setTotalAmount(Files, m_fileCount);
+    setProcessedAmount(Files, m_finishedCount);
+    setTotalAmount(Bytes, total);
+    setProcessedAmount(Bytes, processed);
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef RECEIVEBATCHJOB_H
+#define RECEIVEBATCHJOB_H
+
+#include <QHash>
+#include <QTimer>
+
+#include <KJob>
+
+class ReceiveFileJob;
+
+/**
+ * Groups files pushed by one device in a quick succession.
+ *
+ * The batch shows up as a single job with combined progress once its first
+ * file is accepted. Files pushed while the batch is still open are accepted
+ * without asking again. The batch finishes when no new file arrives within
+ * a short time after the last one.
+ */
+class ReceiveBatchJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    explicit ReceiveBatchJob(const QString &address, QObject *parent = nullptr);
+
+    QString deviceAddress() const;
+
+    // At least one file of this batch was accepted
+    bool isAccepted() const;
+
+    void addFile(ReceiveFileJob *job);
+
+    void start() override;
+
+protected:
+    bool doKill() override;
+
+private Q_SLOTS:
+    void fileAccepted();
+    void fileAmountChanged(KJob *job, KJob::Unit unit, qulonglong amount);
+    void fileFinished(KJob *job);
+    void finishBatch();
+
+private:
+    void updateAmounts();
+
+    struct Progress
+    {
+        qulonglong total = 0;
+        qulonglong processed = 0;
+    };
+
+    QString m_address;
+    bool m_accepted;
+    int m_fileCount;
+    int m_finishedCount;
+    int m_failedCount;
+    QString m_errorText;
+    qulonglong m_finishedBytes;
+
+    QHash<KJob*, Progress> m_activeFiles;
+    QTimer m_timer;
+};
+
+#endif // RECEIVEBATCHJOB_H
@@ -0,0 +1,178 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "receivedfilesindex.h"
+#include "debug_p.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+
+#include <sys/stat.h>
+
+// Start of the index file, files without it use the old format without mtime and inode
+static const quint32 s_magic = 0x42445249; // "BDRI"
+static const quint32 s_version = 2;
+
+ReceivedFilesIndex::ReceivedFilesIndex()
+    : m_fileName(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/bluedevil/receivedfiles.index"))
+    , m_staleEntries(0)
+    , m_loaded(false)
+{
+}
+
+QString ReceivedFilesIndex::find(const QByteArray &hash, quint64 size)
+{
+    load();
+
+    if (!m_entries.contains(hash)) {
+        return QString();
+    }
+
+    const Entry &entry = m_entries.value(hash);
+    Entry current;
+
+    // Cheap check that the file was not changed or replaced since it was received
+    if (entry.size != size || !readFileStamp(entry.path, &current)
+            || current.size != entry.size || current.mtime != entry.mtime || current.inode != entry.inode) {
+        qCDebug(BLUEDAEMON) << "Dropping changed file from index" << entry.path;
+        m_entries.remove(hash);
+        m_staleEntries++;
+        return QString();
+    }
+
+    return entry.path;
+}
+
+void ReceivedFilesIndex::add(const QByteArray &hash, const QString &filePath, quint64 size)
+{
+    load();
+
+    if (m_entries.contains(hash)) {
+        m_staleEntries++;
+    }
+
+    Entry entry;
+    if (!readFileStamp(filePath, &entry) || entry.size != size) {
+        qCWarning(BLUEDAEMON) << "Not adding" << filePath << "to index, it changed while being received";
+        m_entries.remove(hash);
+        return;
+    }
+    m_entries.insert(hash, entry);
+
+    if (m_staleEntries > 100 && m_staleEntries > m_entries.count()) {
+        compact();
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCWarning(BLUEDAEMON) << "Error opening" << m_fileName << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    if (file.size() == 0) {
+        stream << s_magic << s_version;
+    }
+    stream << hash << entry.path << entry.size << entry.mtime << entry.inode;
+}
+
+bool ReceivedFilesIndex::readFileStamp(const QString &filePath, Entry *entry)
+{
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    entry->path = filePath;
+    entry->size = st.st_size;
+    entry->mtime = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    entry->inode = st.st_ino;
+    return true;
+}
+
+void ReceivedFilesIndex::load()
+{
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+
+    // Entries of the old format can't be verified, start over
+    if (magic != s_magic || version != s_version) {
+        file.close();
+        file.remove();
+        return;
+    }
+
+    while (!stream.atEnd()) {
+        QByteArray hash;
+        Entry entry;
+        stream >> hash >> entry.path >> entry.size >> entry.mtime >> entry.inode;
+
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+
+        // Later entries replace earlier ones
+        if (m_entries.contains(hash)) {
+            m_staleEntries++;
+        }
+        m_entries.insert(hash, entry);
+    }
+
+    qCDebug(BLUEDAEMON) << "Loaded" << m_entries.count() << "received files from index";
+}
+
+void ReceivedFilesIndex::compact()
+{
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << s_magic << s_version;
+
+    QHash<QByteArray, Entry>::const_iterator it;
+    for (it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        stream << it.key() << it.value().path << it.value().size << it.value().mtime << it.value().inode;
+    }
+
+    if (file.commit()) {
+        m_staleEntries = 0;
+    }
+}
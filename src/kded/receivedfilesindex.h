@@ -0,0 +1,66 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef RECEIVEDFILESINDEX_H
+#define RECEIVEDFILESINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * Index of received files by their SHA-256 hash.
+ *
+ * Entries are appended to a small binary log file, which is compacted once
+ * it contains too many entries for files that were removed or changed.
+ * A file only counts as unchanged while its size, mtime and inode still
+ * match the ones it had when it was added.
+ */
+class ReceivedFilesIndex
+{
+public:
+    ReceivedFilesIndex();
+
+    // Returns path of a previously received file with the same contents, if it still exists
+    QString find(const QByteArray &hash, quint64 size);
+
+    void add(const QByteArray &hash, const QString &filePath, quint64 size);
+
+private:
+    struct Entry
+    {
+        QString path;
+        quint64 size = 0;
+        // ns since epoch
+        qint64 mtime = 0;
+        quint64 inode = 0;
+    };
+
+    static bool readFileStamp(const QString &filePath, Entry *entry);
+
+    void load();
+    void compact();
+
+    QString m_fileName;
+    QHash<QByteArray, Entry> m_entries;
+    int m_staleEntries;
+    bool m_loaded;
+};
+
+#endif // RECEIVEDFILESINDEX_H
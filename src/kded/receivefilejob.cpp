@@ -20,23 +20,71 @@
 #include "receivefilejob.h"
 #include "filereceiversettings.h"
 #include "obexagent.h"
+#include "receivedfilesindex.h"
+#include "filehasher.h"
+#include "transferthrottle.h"
+#include "deviceindex.h"
 #include "debug_p.h"
+#include "../common/fileallocation.h"
+#include "../common/transfersize.h"
 
 #include <QDir>
 #include <QIcon>
-#include <QTimer>
+#include <QFileInfo>
 #include <QTemporaryFile>
 
 #include <KIO/CopyJob>
+#include <KIO/SimpleJob>
+#include <KIO/TransferJob>
 #include <KNotification>
 #include <KLocalizedString>
-#include <KJobTrackerInterface>
 
 #include <BluezQt/Manager>
 #include <BluezQt/Adapter>
 #include <BluezQt/Device>
 #include <BluezQt/ObexSession>
 
+#include <sys/ioctl.h>
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#endif
+
+// Names tried when the target name is taken while renaming the partial file
+static const int s_maxRenameAttempts = 5;
+
+// Returns path in dir that doesn't exist yet, appending a number to fileName if needed
+static QString uniquePath(const QString &dir, const QString &fileName)
+{
+    const QString base = dir + QLatin1Char('/') + fileName;
+    QString path = base;
+
+    int i = 0;
+    while (QFile::exists(path)) {
+        path = base + QString::number(i);
+        i++;
+    }
+
+    return path;
+}
+
+// Makes target share the data of source if the filesystem supports it (btrfs, xfs)
+static bool cloneFile(const QString &source, const QString &target)
+{
+#ifdef FICLONE
+    QFile sourceFile(source);
+    QFile targetFile(target);
+    if (!sourceFile.open(QIODevice::ReadOnly) || !targetFile.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    return ioctl(targetFile.handle(), FICLONE, sourceFile.handle()) == 0;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(target)
+    return false;
+#endif
+}
+
 ReceiveFileJob::ReceiveFileJob(const BluezQt::Request<QString> &req, BluezQt::ObexTransferPtr transfer, BluezQt::ObexSessionPtr session, ObexAgent *parent)
     : KJob(parent)
     , m_speedBytes(0)
@@ -45,15 +93,54 @@ ReceiveFileJob::ReceiveFileJob(const BluezQt::Request<QString> &req, BluezQt::Ob
     , m_session(session)
     , m_request(req)
     , m_accepted(false)
+    , m_receiveInPlace(false)
+    , m_hasher(nullptr)
+    , m_uploadJob(nullptr)
+    , m_uploaded(0)
+    , m_uploadDataRequested(false)
+    , m_transferComplete(false)
 {
     setCapabilities(Killable);
 }
 
+ReceiveFileJob::~ReceiveFileJob()
+{
+    // Deleted in its thread once it is done with queued work
+    if (m_hasher) {
+        m_hasher->deleteLater();
+    }
+}
+
 QString ReceiveFileJob::deviceAddress() const
 {
     return m_deviceAddress;
 }
 
+QString ReceiveFileJob::deviceName() const
+{
+    return m_deviceName;
+}
+
+QString ReceiveFileJob::fileName() const
+{
+    return m_transfer->name();
+}
+
+QUrl ReceiveFileJob::targetUrl() const
+{
+    return m_targetPath;
+}
+
+bool ReceiveFileJob::isAccepted() const
+{
+    return m_accepted;
+}
+
+QDateTime ReceiveFileJob::startTime() const
+{
+    return m_startTime;
+}
+
 void ReceiveFileJob::start()
 {
     QMetaObject::invokeMethod(this, "init", Qt::QueuedConnection);
@@ -63,6 +150,12 @@ bool ReceiveFileJob::doKill()
 {
     qCDebug(BLUEDAEMON) << "ReceiveFileJob-Kill";
     m_transfer->cancel();
+
+    abortUpload();
+
+    if (m_receiveInPlace) {
+        QFile::remove(m_tempPath);
+    }
     return true;
 }
 
@@ -85,16 +178,9 @@ void ReceiveFileJob::init()
 
     m_deviceName = m_session->destination();
 
-    BluezQt::AdapterPtr adapter = m_agent->manager()->adapterForAddress(m_session->source());
-    if (!adapter) {
-        qCDebug(BLUEDAEMON) << "No adapter for" << m_session->source();
-        showNotification();
-        return;
-    }
-
-    BluezQt::DevicePtr device = adapter->deviceForAddress(m_session->destination());
+    BluezQt::DevicePtr device = m_agent->deviceIndex()->device(m_session->source(), m_session->destination());
     if (!device) {
-        qCDebug(BLUEDAEMON) << "No device for" << m_session->destination();
+        qCDebug(BLUEDAEMON) << "No device for" << m_session->source() << m_session->destination();
         showNotification();
         return;
     }
@@ -107,7 +193,6 @@ void ReceiveFileJob::init()
         return;
     }
 
-    FileReceiverSettings::self()->load();
     switch (FileReceiverSettings::self()->autoAccept()) {
     case 0: // Never auto-accept transfers
         showNotification();
@@ -162,9 +247,7 @@ void ReceiveFileJob::slotAccept()
 {
     qCDebug(BLUEDAEMON) << "ReceiveFileJob-Accept";
 
-    KIO::getJobTracker()->registerJob(this);
-
-    FileReceiverSettings::self()->load();
+    // Settings were loaded when the batch started
     m_targetPath = FileReceiverSettings::self()->saveUrl().adjusted(QUrl::StripTrailingSlash);
     m_targetPath.setPath(m_targetPath.path() + QLatin1Char('/') + m_transfer->name());
 
@@ -172,11 +255,20 @@ void ReceiveFileJob::slotAccept()
                     QPair<QString, QString>(i18nc("File transfer origin", "From"), m_deviceName),
                     QPair<QString, QString>(i18nc("File transfer destination", "To"), m_targetPath.toDisplayString()));
 
-    m_tempPath = createTempPath(m_transfer->name());
+    // Receive local files right into the target directory, so that they
+    // only need to be renamed once complete instead of copied over
+    if (m_targetPath.isLocalFile() && QDir().mkpath(m_targetPath.adjusted(QUrl::RemoveFilename).toLocalFile())) {
+        m_tempPath = createPartialPath(m_transfer->name());
+        m_receiveInPlace = true;
+    } else {
+        m_tempPath = createTempPath(m_transfer->name());
+    }
     qCDebug(BLUEDAEMON) << "TempPath" << m_tempPath;
 
     m_accepted = true;
     m_request.accept(m_tempPath);
+
+    Q_EMIT accepted();
 }
 
 void ReceiveFileJob::slotCancel()
@@ -200,11 +292,7 @@ void ReceiveFileJob::moveFinished(KJob *job)
         QFile::remove(m_tempPath);
     }
 
-    // Delay emitResult to make sure notification is displayed even
-    // for very small files that are received instantly
-    QTimer::singleShot(500, this, [this]() {
-        emitResult();
-    });
+    emitResult();
 }
 
 void ReceiveFileJob::statusChanged(BluezQt::ObexTransfer::Status status)
@@ -212,16 +300,51 @@ void ReceiveFileJob::statusChanged(BluezQt::ObexTransfer::Status status)
     switch (status) {
     case BluezQt::ObexTransfer::Active:
         qCDebug(BLUEDAEMON) << "ReceiveFileJob-Transfer Active";
+
+        // Resumed after being suspended by the transfer throttle
+        if (m_startTime.isValid()) {
+            break;
+        }
+
+        m_agent->transferThrottle()->addTransfer(m_transfer, m_session->objectPath());
+
         setTotalAmount(Bytes, m_transfer->size());
         setProcessedAmount(Bytes, 0);
-        m_time = QTime::currentTime();
+        m_time.start();
+        m_startTime = QDateTime::currentDateTime();
+
+        // obexd truncates the file when opening it, so this can only be done now
+        if (m_receiveInPlace) {
+            QString errorString;
+            if (!preallocateFile(m_tempPath, m_transfer->size(), &errorString)) {
+                qCDebug(BLUEDAEMON) << "Preallocating" << m_tempPath << "failed:" << errorString;
+            }
+        } else if (!m_targetPath.isLocalFile()) {
+            startUpload();
+        }
         break;
 
     case BluezQt::ObexTransfer::Complete: {
         qCDebug(BLUEDAEMON) << "ReceiveFileJob-Transfer Complete";
-        KIO::CopyJob *job = KIO::move(QUrl::fromLocalFile(m_tempPath), m_targetPath, KIO::HideProgressInfo);
-        job->setUiDelegate(nullptr);
-        connect(job, &KIO::CopyJob::finished, this, &ReceiveFileJob::moveFinished);
+
+        m_transferComplete = true;
+
+        if (m_receiveInPlace) {
+            // Continues in hashFinished
+            FileHasher *fileHasher = hasher();
+            QMetaObject::invokeMethod(fileHasher, [fileHasher]() {
+                fileHasher->finish();
+            }, Qt::QueuedConnection);
+            break;
+        }
+
+        // The upload finishes the job once it sent the rest of the file
+        if (m_uploadJob) {
+            feedUpload();
+            break;
+        }
+
+        moveToTarget();
         break;
     }
 
@@ -230,11 +353,17 @@ void ReceiveFileJob::statusChanged(BluezQt::ObexTransfer::Status status)
         setError(KJob::UserDefinedError);
         setErrorText(i18n("Bluetooth transfer failed"));
 
-        // Delay emitResult to make sure notification is displayed even
-        // when transfer errors right after accepting it
-        QTimer::singleShot(500, this, [this]() {
-            emitResult();
-        });
+        if (m_receiveInPlace) {
+            QFile::remove(m_tempPath);
+        }
+
+        abortUpload();
+
+        emitResult();
+        break;
+
+    case BluezQt::ObexTransfer::Suspended:
+        qCDebug(BLUEDAEMON) << "ReceiveFileJob-Transfer Suspended";
         break;
 
     default:
@@ -248,16 +377,25 @@ void ReceiveFileJob::transferredChanged(quint64 transferred)
     // qCDebug(BLUEDAEMON) << "ReceiveFileJob-Transferred" << transferred;
 
     // If at least 1 second has passed since last update
-    int secondsSinceLastTime = m_time.secsTo(QTime::currentTime());
-    if (secondsSinceLastTime > 0) {
-        unsigned long speed = (transferred - m_speedBytes) / secondsSinceLastTime;
+    const qint64 msecsSinceLastTime = m_time.elapsed();
+    if (msecsSinceLastTime >= 1000) {
+        const quint64 speed = TransferSize::speed(transferred - m_speedBytes, msecsSinceLastTime);
         emitSpeed(speed);
 
-        m_time = QTime::currentTime();
+        m_time.restart();
         m_speedBytes = transferred;
     }
 
     setProcessedAmount(Bytes, transferred);
+
+    feedUpload();
+
+    if (m_receiveInPlace) {
+        FileHasher *fileHasher = hasher();
+        QMetaObject::invokeMethod(fileHasher, [fileHasher, transferred]() {
+            fileHasher->update(transferred);
+        }, Qt::QueuedConnection);
+    }
 }
 
 QString ReceiveFileJob::createTempPath(const QString &fileName) const
@@ -267,14 +405,205 @@ QString ReceiveFileJob::createTempPath(const QString &fileName) const
         xdgCacheHome = QDir::homePath() + QStringLiteral("/.cache");
     }
 
-    xdgCacheHome.append(QLatin1String("/obexd/"));
-    QString path = xdgCacheHome + fileName;
+    return uniquePath(xdgCacheHome + QLatin1String("/obexd"), fileName);
+}
+
+QString ReceiveFileJob::createPartialPath(const QString &fileName) const
+{
+    const QString dir = m_targetPath.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash).toLocalFile();
+    return uniquePath(dir, QLatin1Char('.') + fileName + QLatin1String(".part"));
+}
 
-    int i = 0;
-    while (QFile::exists(path)) {
-        path = xdgCacheHome + fileName + QString::number(i);
-        i++;
+void ReceiveFileJob::hashFinished(const QByteArray &hash, quint64 size)
+{
+    // Killed while the rest of the file was being hashed
+    if (error()) {
+        return;
     }
 
-    return path;
+    renamePartialFile(hash, size);
+}
+
+void ReceiveFileJob::renamePartialFile(const QByteArray &hash, quint64 size)
+{
+    const QFileInfo target(m_targetPath.toLocalFile());
+
+    ReceivedFilesIndex *index = m_agent->receivedFilesIndex();
+    const QString existing = index->find(hash, size);
+
+    if (!existing.isEmpty()) {
+        if (QFileInfo(existing).absolutePath() == target.absolutePath()) {
+            qCDebug(BLUEDAEMON) << "Dropping duplicate of" << existing;
+            QFile::remove(m_tempPath);
+            m_targetPath = QUrl::fromLocalFile(existing);
+            emitResult();
+            return;
+        }
+
+        // Received to a different folder, keep the file but share its data
+        if (cloneFile(existing, m_tempPath)) {
+            qCDebug(BLUEDAEMON) << "Cloned duplicate of" << existing;
+        }
+    }
+
+    // Both files are in the same directory, so this is an atomic rename. QFile
+    // doesn't replace an existing file, so another writer taking the name
+    // between uniquePath() and the rename only means trying the next name.
+    for (int attempt = 0; attempt < s_maxRenameAttempts; ++attempt) {
+        const QString targetPath = uniquePath(target.absolutePath(), target.fileName());
+
+        if (QFile::rename(m_tempPath, targetPath)) {
+            m_targetPath = QUrl::fromLocalFile(targetPath);
+            index->add(hash, targetPath, size);
+            emitResult();
+            return;
+        }
+
+        qCWarning(BLUEDAEMON) << "Renaming" << m_tempPath << "to" << targetPath << "failed";
+    }
+
+    // Never throw away the received data, leave it in the partial file
+    setError(KJob::UserDefinedError);
+    setErrorText(i18n("Saving file failed, the received data was kept in %1", m_tempPath));
+    emitResult();
+}
+
+FileHasher *ReceiveFileJob::hasher()
+{
+    if (!m_hasher) {
+        m_hasher = new FileHasher(m_tempPath);
+        m_hasher->moveToThread(m_agent->hashThread());
+        connect(m_hasher, &FileHasher::finished, this, &ReceiveFileJob::hashFinished);
+    }
+    return m_hasher;
+}
+
+void ReceiveFileJob::moveToTarget()
+{
+    KIO::CopyJob *job = KIO::move(QUrl::fromLocalFile(m_tempPath), m_targetPath, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    connect(job, &KIO::CopyJob::finished, this, &ReceiveFileJob::moveFinished);
+}
+
+void ReceiveFileJob::startUpload()
+{
+    // Uploaded under a temporary name, so that a failed upload never leaves
+    // a truncated file at the target or blocks the fallback move
+    m_uploadUrl = m_targetPath.adjusted(QUrl::RemoveFilename);
+    m_uploadUrl.setPath(m_uploadUrl.path() + QLatin1Char('.') + m_targetPath.fileName() + QLatin1String(".part"));
+
+    qCDebug(BLUEDAEMON) << "Uploading to" << m_uploadUrl << "while receiving";
+
+    // Data is sent as it arrives, so both transfers run at the same time
+    m_uploadJob = KIO::put(m_uploadUrl, -1, KIO::Overwrite | KIO::HideProgressInfo);
+    m_uploadJob->setUiDelegate(nullptr);
+    m_uploadJob->setAsyncDataEnabled(true);
+    m_uploadJob->setTotalSize(m_transfer->size());
+
+    connect(m_uploadJob, &KIO::TransferJob::dataReq, this, &ReceiveFileJob::uploadDataRequested);
+    connect(m_uploadJob, &KIO::TransferJob::result, this, &ReceiveFileJob::uploadFinished);
+}
+
+void ReceiveFileJob::uploadDataRequested(KIO::Job *job, QByteArray &data)
+{
+    Q_UNUSED(job)
+    Q_UNUSED(data)
+
+    // Data is sent with sendAsyncData() once available
+    m_uploadDataRequested = true;
+    feedUpload();
+}
+
+void ReceiveFileJob::feedUpload()
+{
+    if (!m_uploadJob || !m_uploadDataRequested) {
+        return;
+    }
+
+    if (!m_uploadFile.isOpen()) {
+        m_uploadFile.setFileName(m_tempPath);
+        if (!m_uploadFile.open(QIODevice::ReadOnly)) {
+            return;
+        }
+    }
+
+    const quint64 available = m_transferComplete ? quint64(m_uploadFile.size()) : m_transfer->transferred();
+    const quint64 chunkSize = 64 * 1024;
+
+    QByteArray data;
+    if (available > m_uploaded) {
+        data = m_uploadFile.read(qMin(available - m_uploaded, chunkSize));
+    }
+
+    if (data.isEmpty()) {
+        // Empty data tells the upload that the file is complete
+        if (m_transferComplete) {
+            m_uploadDataRequested = false;
+            m_uploadJob->sendAsyncData(QByteArray());
+        }
+        return;
+    }
+
+    m_uploaded += data.size();
+    m_uploadDataRequested = false;
+    m_uploadJob->sendAsyncData(data);
+}
+
+void ReceiveFileJob::uploadFinished(KJob *job)
+{
+    if (job != m_uploadJob) {
+        return;
+    }
+
+    m_uploadJob = nullptr;
+    m_uploadFile.close();
+
+    if (job->error()) {
+        // Fall back to moving the file once it is complete
+        qCWarning(BLUEDAEMON) << "Uploading to" << m_uploadUrl << "failed:" << job->errorText();
+        removeUpload();
+        if (m_transferComplete) {
+            moveToTarget();
+        }
+        return;
+    }
+
+    KIO::SimpleJob *renameJob = KIO::rename(m_uploadUrl, m_targetPath, KIO::HideProgressInfo);
+    renameJob->setUiDelegate(nullptr);
+    connect(renameJob, &KJob::result, this, &ReceiveFileJob::uploadRenamed);
+}
+
+void ReceiveFileJob::uploadRenamed(KJob *job)
+{
+    if (job->error()) {
+        qCWarning(BLUEDAEMON) << "Renaming" << m_uploadUrl << "to" << m_targetPath << "failed:" << job->errorText();
+        removeUpload();
+        moveToTarget();
+        return;
+    }
+
+    m_uploadUrl.clear();
+    QFile::remove(m_tempPath);
+    moveFinished(job);
+}
+
+void ReceiveFileJob::abortUpload()
+{
+    if (m_uploadJob) {
+        m_uploadJob->kill();
+        m_uploadJob = nullptr;
+    }
+
+    removeUpload();
+}
+
+void ReceiveFileJob::removeUpload()
+{
+    if (m_uploadUrl.isEmpty()) {
+        return;
+    }
+
+    KIO::SimpleJob *job = KIO::file_delete(m_uploadUrl, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    m_uploadUrl.clear();
 }
@@ -21,14 +21,23 @@
 #define RECEIVEFILEJOB_H
 
 #include <QUrl>
-#include <QTime>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QDateTime>
 
 #include <KJob>
 
 #include <BluezQt/Request>
 #include <BluezQt/ObexTransfer>
 
+namespace KIO
+{
+    class Job;
+    class TransferJob;
+}
+
 class ObexAgent;
+class FileHasher;
 
 class ReceiveFileJob : public KJob
 {
@@ -36,27 +45,51 @@ class ReceiveFileJob : public KJob
 
 public:
     explicit ReceiveFileJob(const BluezQt::Request<QString> &req, BluezQt::ObexTransferPtr transfer, BluezQt::ObexSessionPtr session, ObexAgent *parent);
+    ~ReceiveFileJob() override;
 
     QString deviceAddress() const;
+    QString deviceName() const;
+    QString fileName() const;
+    QUrl targetUrl() const;
+    bool isAccepted() const;
+
+    // When the transfer became active
+    QDateTime startTime() const;
 
     void start() override;
     bool doKill() override;
 
+Q_SIGNALS:
+    void accepted();
+
 private Q_SLOTS:
     void init();
     void showNotification();
     void slotCancel();
     void slotAccept();
     void moveFinished(KJob *job);
+    void uploadDataRequested(KIO::Job *job, QByteArray &data);
+    void uploadFinished(KJob *job);
+    void uploadRenamed(KJob *job);
+    void hashFinished(const QByteArray &hash, quint64 size);
 
     void statusChanged(BluezQt::ObexTransfer::Status status);
     void transferredChanged(quint64 transferred);
 
 private:
     QString createTempPath(const QString &fileName) const;
-
-    QTime m_time;
-    qulonglong m_speedBytes;
+    QString createPartialPath(const QString &fileName) const;
+    void renamePartialFile(const QByteArray &hash, quint64 size);
+    FileHasher *hasher();
+    void moveToTarget();
+    void startUpload();
+    void feedUpload();
+    void abortUpload();
+    void removeUpload();
+
+    QElapsedTimer m_time;
+    QDateTime m_startTime;
+    quint64 m_speedBytes;
     QString m_tempPath;
     QString m_deviceName;
     QString m_deviceAddress;
@@ -67,6 +100,19 @@ private:
     BluezQt::ObexSessionPtr m_session;
     BluezQt::Request<QString> m_request;
     bool m_accepted;
+    bool m_receiveInPlace;
+
+    // Hashes the received data in a worker thread, to find duplicates of already received files
+    FileHasher *m_hasher;
+
+    // Streaming of the received data to a remote save location
+    KIO::TransferJob *m_uploadJob;
+    // Temporary name of the upload at the target, until it is renamed
+    QUrl m_uploadUrl;
+    QFile m_uploadFile;
+    quint64 m_uploaded;
+    bool m_uploadDataRequested;
+    bool m_transferComplete;
 };
 
 #endif // RECEIVEFILEJOB_H
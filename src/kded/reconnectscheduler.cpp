@@ -0,0 +1,187 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "reconnectscheduler.h"
+#include "debug_p.h"
+#include "../common/bluetoothservices.h"
+
+#include <QDateTime>
+
+#include <BluezQt/Manager>
+#include <BluezQt/Device>
+#include <BluezQt/PendingCall>
+
+#include <algorithm>
+
+// Devices paged at the same time
+static const int s_maxConcurrent = 2;
+
+// Attempts before giving up on a device
+static const int s_maxAttempts = 5;
+
+// Delay before the first retry, doubled with every further attempt
+static const int s_firstRetryDelay = 2000;
+
+static bool isAudioDevice(BluezQt::DevicePtr device)
+{
+    return BluetoothServices::fromUuids(device->uuids()) & BluetoothServices::AudioServices;
+}
+
+ReconnectScheduler::ReconnectScheduler(BluezQt::Manager *manager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_batchFailed(false)
+    , m_lastBatchDuration(-1)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &ReconnectScheduler::startPending);
+}
+
+void ReconnectScheduler::schedule(BluezQt::DevicePtr device, qint64 lastUsed)
+{
+    if (device->isConnected()) {
+        return;
+    }
+
+    Q_FOREACH (const Request &r, m_pending) {
+        if (r.ubi == device->ubi()) {
+            return;
+        }
+    }
+
+    Q_FOREACH (const Request &r, m_running) {
+        if (r.ubi == device->ubi()) {
+            return;
+        }
+    }
+
+    if (!m_batchTime.isValid()) {
+        m_batchTime.start();
+        m_batchFailed = false;
+    }
+
+    Request request;
+    request.ubi = device->ubi();
+    request.audio = isAudioDevice(device);
+    request.lastUsed = lastUsed;
+    m_pending.append(request);
+
+    qCDebug(BLUEDAEMON) << "Scheduled reconnect of" << device->address() << "audio:" << request.audio;
+
+    // Let all devices of a batch get queued before picking the first ones
+    QTimer::singleShot(0, this, &ReconnectScheduler::startPending);
+}
+
+void ReconnectScheduler::clear()
+{
+    m_pending.clear();
+    m_timer.stop();
+
+    if (m_running.isEmpty()) {
+        m_batchTime.invalidate();
+    }
+}
+
+qint64 ReconnectScheduler::lastBatchDuration() const
+{
+    return m_lastBatchDuration;
+}
+
+void ReconnectScheduler::startPending()
+{
+    std::stable_sort(m_pending.begin(), m_pending.end(), [](const Request &a, const Request &b) {
+        if (a.audio != b.audio) {
+            return a.audio;
+        }
+        return a.lastUsed > b.lastUsed;
+    });
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 nextRetry = 0;
+
+    for (int i = 0; i < m_pending.count() && m_running.count() < s_maxConcurrent;) {
+        const Request request = m_pending.at(i);
+
+        if (request.notBefore > now) {
+            nextRetry = nextRetry ? qMin(nextRetry, request.notBefore) : request.notBefore;
+            ++i;
+            continue;
+        }
+
+        m_pending.removeAt(i);
+
+        BluezQt::DevicePtr device = m_manager->deviceForUbi(request.ubi);
+        if (!device || device->isConnected()) {
+            continue;
+        }
+
+        qCDebug(BLUEDAEMON) << "Reconnecting" << device->address() << "attempt" << request.attempts + 1;
+
+        BluezQt::PendingCall *call = device->connectToDevice();
+        m_running.insert(call, request);
+        connect(call, &BluezQt::PendingCall::finished, this, &ReconnectScheduler::connectFinished);
+    }
+
+    // Requests after the concurrency limit was hit are started from connectFinished
+    if (nextRetry && m_running.count() < s_maxConcurrent) {
+        m_timer.start(static_cast<int>(qMax<qint64>(0, nextRetry - now)));
+    }
+
+    if (m_pending.isEmpty() && m_running.isEmpty()) {
+        finishBatch();
+    }
+}
+
+void ReconnectScheduler::connectFinished(BluezQt::PendingCall *call)
+{
+    Request request = m_running.take(call);
+    BluezQt::DevicePtr device = m_manager->deviceForUbi(request.ubi);
+
+    if (call->error() && device && !device->isConnected()) {
+        request.attempts++;
+
+        if (request.attempts < s_maxAttempts) {
+            const int delay = s_firstRetryDelay << (request.attempts - 1);
+            request.notBefore = QDateTime::currentMSecsSinceEpoch() + delay;
+            m_pending.append(request);
+            qCDebug(BLUEDAEMON) << "Reconnecting" << device->address() << "failed:" << call->errorText() << "retrying in" << delay << "ms";
+        } else {
+            m_batchFailed = true;
+            qCWarning(BLUEDAEMON) << "Giving up reconnecting" << device->address() << "after" << request.attempts << "attempts:" << call->errorText();
+        }
+    } else if (device) {
+        qCDebug(BLUEDAEMON) << "Reconnected" << device->address();
+    }
+
+    startPending();
+}
+
+void ReconnectScheduler::finishBatch()
+{
+    if (!m_batchTime.isValid()) {
+        return;
+    }
+
+    m_lastBatchDuration = m_batchTime.elapsed();
+    m_batchTime.invalidate();
+
+    qCDebug(BLUEDAEMON) << "Reconnect batch finished in" << m_lastBatchDuration << "ms, all connected:" << !m_batchFailed;
+
+    Q_EMIT batchFinished(m_lastBatchDuration, !m_batchFailed);
+}
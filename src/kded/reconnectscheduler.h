@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef RECONNECTSCHEDULER_H
+#define RECONNECTSCHEDULER_H
+
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QObject>
+#include <QElapsedTimer>
+
+#include <BluezQt/Types>
+
+namespace BluezQt
+{
+class PendingCall;
+}
+
+/**
+ * Reconnects devices without letting the connection attempts contend.
+ *
+ * Only a few devices are paged at the same time. Audio devices go first,
+ * then the most recently used ones. A failed attempt is retried later with
+ * an exponential backoff. The time it took to reconnect all devices of
+ * a batch is measured.
+ */
+class ReconnectScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReconnectScheduler(BluezQt::Manager *manager, QObject *parent = nullptr);
+
+    // Queues a reconnect, lastUsed is the time of its last connection (ms since epoch)
+    void schedule(BluezQt::DevicePtr device, qint64 lastUsed);
+
+    // Drops all queued reconnects, running attempts are left to finish
+    void clear();
+
+    // Time (ms) it took to reconnect the devices of the last batch, -1 if none finished yet
+    qint64 lastBatchDuration() const;
+
+Q_SIGNALS:
+    void batchFinished(qint64 msecs, bool allConnected);
+
+private Q_SLOTS:
+    void startPending();
+    void connectFinished(BluezQt::PendingCall *call);
+
+private:
+    struct Request
+    {
+        QString ubi;
+        bool audio = false;
+        qint64 lastUsed = 0;
+        int attempts = 0;
+        // ms since epoch before which the device won't be paged again
+        qint64 notBefore = 0;
+    };
+
+    void finishBatch();
+
+    BluezQt::Manager *m_manager;
+    QList<Request> m_pending;
+    QHash<BluezQt::PendingCall*, Request> m_running;
+    QTimer m_timer;
+    QElapsedTimer m_batchTime;
+    bool m_batchFailed;
+    qint64 m_lastBatchDuration;
+};
+
+#endif // RECONNECTSCHEDULER_H
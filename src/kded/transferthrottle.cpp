@@ -0,0 +1,205 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "transferthrottle.h"
+#include "debug_p.h"
+
+#include <BluezQt/Manager>
+#include <BluezQt/Device>
+#include <BluezQt/ObexTransfer>
+#include <BluezQt/ObexSession>
+#include <BluezQt/ObexManager>
+#include <BluezQt/PendingCall>
+
+// Duty cycle while audio is playing: transfers run for s_runInterval
+// and are suspended for s_pauseInterval milliseconds
+static const int s_runInterval = 600;
+static const int s_pauseInterval = 400;
+
+TransferThrottle::TransferThrottle(BluezQt::Manager *manager, BluezQt::ObexManager *obexManager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_active(false)
+    , m_suspended(false)
+{
+    m_dutyTimer.setSingleShot(true);
+    connect(&m_dutyTimer, &QTimer::timeout, this, &TransferThrottle::toggleSuspended);
+
+    connect(m_manager, &BluezQt::Manager::deviceAdded, this, &TransferThrottle::deviceAdded);
+    connect(m_manager, &BluezQt::Manager::deviceRemoved, this, &TransferThrottle::updateActive);
+    connect(obexManager, &BluezQt::ObexManager::sessionRemoved, this, &TransferThrottle::sessionRemoved);
+
+    Q_FOREACH (BluezQt::DevicePtr device, m_manager->devices()) {
+        deviceAdded(device);
+    }
+}
+
+bool TransferThrottle::isActive() const
+{
+    return m_active;
+}
+
+void TransferThrottle::addTransfer(BluezQt::ObexTransferPtr transfer, const QDBusObjectPath &session)
+{
+    if (!transfer) {
+        return;
+    }
+
+    Q_FOREACH (const Transfer &t, m_transfers) {
+        if (t.transfer == transfer) {
+            return;
+        }
+    }
+
+    BluezQt::ObexTransfer *t = transfer.data();
+    connect(t, &BluezQt::ObexTransfer::statusChanged, this, [this, t](BluezQt::ObexTransfer::Status status) {
+        if (status == BluezQt::ObexTransfer::Complete || status == BluezQt::ObexTransfer::Error) {
+            removeTransfer(t);
+        }
+    });
+    connect(t, &QObject::destroyed, this, [this, t]() {
+        removeTransfer(t);
+    });
+
+    Transfer entry;
+    entry.transfer = transfer;
+    entry.session = session;
+    m_transfers.append(entry);
+
+    if (m_suspended) {
+        transfer->suspend();
+    }
+
+    updateDutyCycle();
+}
+
+void TransferThrottle::deviceAdded(BluezQt::DevicePtr device)
+{
+    connect(device.data(), &BluezQt::Device::mediaPlayerChanged, this, &TransferThrottle::mediaPlayerChanged, Qt::UniqueConnection);
+    watchMediaPlayer(device->mediaPlayer());
+}
+
+void TransferThrottle::mediaPlayerChanged(BluezQt::MediaPlayerPtr player)
+{
+    watchMediaPlayer(player);
+    updateActive();
+}
+
+void TransferThrottle::updateActive()
+{
+    bool active = false;
+
+    Q_FOREACH (BluezQt::DevicePtr device, m_manager->devices()) {
+        BluezQt::MediaPlayerPtr player = device->mediaPlayer();
+        if (player && player->status() == BluezQt::MediaPlayer::Playing) {
+            active = true;
+            break;
+        }
+    }
+
+    if (m_active == active) {
+        return;
+    }
+
+    qCDebug(BLUEDAEMON) << "Throttling OBEX transfers:" << active;
+
+    m_active = active;
+    updateDutyCycle();
+
+    Q_EMIT activeChanged(m_active);
+}
+
+void TransferThrottle::toggleSuspended()
+{
+    setSuspended(!m_suspended);
+    m_dutyTimer.start(m_suspended ? s_pauseInterval : s_runInterval);
+}
+
+void TransferThrottle::sessionRemoved(BluezQt::ObexSessionPtr session)
+{
+    // Transfers of a dropped session may never reach Complete or Error
+    for (int i = 0; i < m_transfers.count(); ++i) {
+        if (m_transfers.at(i).session == session->objectPath()) {
+            BluezQt::ObexTransfer *transfer = m_transfers.at(i).transfer.data();
+            if (transfer) {
+                disconnect(transfer, nullptr, this, nullptr);
+            }
+            m_transfers.removeAt(i--);
+        }
+    }
+
+    updateDutyCycle();
+}
+
+void TransferThrottle::updateDutyCycle()
+{
+    if (m_active && !m_transfers.isEmpty()) {
+        if (!m_dutyTimer.isActive()) {
+            m_dutyTimer.start(m_suspended ? s_pauseInterval : s_runInterval);
+        }
+    } else {
+        m_dutyTimer.stop();
+        setSuspended(false);
+    }
+}
+
+void TransferThrottle::watchMediaPlayer(BluezQt::MediaPlayerPtr player)
+{
+    if (!player) {
+        return;
+    }
+
+    connect(player.data(), &BluezQt::MediaPlayer::statusChanged, this, &TransferThrottle::updateActive, Qt::UniqueConnection);
+    updateActive();
+}
+
+void TransferThrottle::removeTransfer(BluezQt::ObexTransfer *transfer)
+{
+    for (int i = 0; i < m_transfers.count(); ++i) {
+        if (m_transfers.at(i).transfer.data() == transfer) {
+            disconnect(transfer, nullptr, this, nullptr);
+            m_transfers.removeAt(i);
+            updateDutyCycle();
+            return;
+        }
+    }
+}
+
+void TransferThrottle::setSuspended(bool suspended)
+{
+    if (m_suspended == suspended) {
+        return;
+    }
+
+    m_suspended = suspended;
+
+    Q_FOREACH (const Transfer &t, m_transfers) {
+        BluezQt::ObexTransferPtr transfer = t.transfer.toStrongRef();
+        if (!transfer) {
+            continue;
+        }
+
+        // obexd refuses to suspend transfers that are still queued, which is fine
+        if (m_suspended) {
+            transfer->suspend();
+        } else {
+            transfer->resume();
+        }
+    }
+}
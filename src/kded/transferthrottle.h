@@ -0,0 +1,83 @@
+/***************************************************************************
+ *   Copyright (C) 2020 BlueDevil Developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef TRANSFERTHROTTLE_H
+#define TRANSFERTHROTTLE_H
+
+#include <QList>
+#include <QTimer>
+#include <QObject>
+#include <QWeakPointer>
+#include <QDBusObjectPath>
+
+#include <BluezQt/Types>
+#include <BluezQt/MediaPlayer>
+
+/**
+ * Keeps audio playback smooth while OBEX transfers are running.
+ *
+ * OBEX transfers and A2DP streams share the airtime of the controller, so
+ * while any device is playing audio the registered transfers are suspended
+ * and resumed on a duty cycle. Transfers run at full speed again as soon as
+ * playback stops. The duty cycle only runs while there are transfers.
+ */
+class TransferThrottle : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TransferThrottle(BluezQt::Manager *manager, BluezQt::ObexManager *obexManager, QObject *parent = nullptr);
+
+    // Whether audio is playing and transfers are being throttled
+    bool isActive() const;
+
+    // Throttles the transfer until it completes, fails, is destroyed or its session is removed
+    void addTransfer(BluezQt::ObexTransferPtr transfer, const QDBusObjectPath &session);
+
+Q_SIGNALS:
+    void activeChanged(bool active);
+
+private Q_SLOTS:
+    void deviceAdded(BluezQt::DevicePtr device);
+    void mediaPlayerChanged(BluezQt::MediaPlayerPtr player);
+    void updateActive();
+    void toggleSuspended();
+    void sessionRemoved(BluezQt::ObexSessionPtr session);
+
+private:
+    void watchMediaPlayer(BluezQt::MediaPlayerPtr player);
+    void removeTransfer(BluezQt::ObexTransfer *transfer);
+    void setSuspended(bool suspended);
+    void updateDutyCycle();
+
+    BluezQt::Manager *m_manager;
+    struct Transfer
+    {
+        // Weak, so that dropped transfers can be destroyed
+        QWeakPointer<BluezQt::ObexTransfer> transfer;
+        QDBusObjectPath session;
+    };
+
+    QList<Transfer> m_transfers;
+    QTimer m_dutyTimer;
+    bool m_active;
+    bool m_suspended;
+};
+
+#endif // TRANSFERTHROTTLE_H
@@ -23,14 +23,17 @@
 #include "kdedbluedevil.h"
 #include "version.h"
 #include "filereceiversettings.h"
+#include "../../common/transferhistory.h"
+#include "../../common/bluetoothservices.h"
 
 #include <QThread>
+#include <QMimeDatabase>
 #include <QCoreApplication>
 #include <QDBusMetaType>
 
+#include <KFormat>
 #include <KLocalizedString>
 
-#include <BluezQt/Services>
 
 extern "C" int Q_DECL_EXPORT kdemain(int argc, char **argv)
 {
@@ -48,9 +51,14 @@ extern "C" int Q_DECL_EXPORT kdemain(int argc, char **argv)
 
 KioBluetooth::KioBluetooth(const QByteArray &pool, const QByteArray &app)
     : SlaveBase(QByteArrayLiteral("bluetooth"), pool, app)
+    , m_devicesGeneration(0)
+    , m_history(nullptr)
 {
     qDBusRegisterMetaType<DeviceInfo>();
     qDBusRegisterMetaType<QMapDeviceInfo>();
+    qDBusRegisterMetaType<DeviceEntry>();
+    qDBusRegisterMetaType<QList<DeviceEntry>>();
+    qDBusRegisterMetaType<DeviceChanges>();
 
     m_hasCurrentHost = false;
 
@@ -58,16 +66,19 @@ KioBluetooth::KioBluetooth(const QByteArray &pool, const QByteArray &app)
     sendFile.name = i18n("Send File");
     sendFile.icon = QStringLiteral("edit-copy");
     sendFile.mimetype = QStringLiteral("application/vnd.kde.bluedevil-sendfile");
-    sendFile.uuid = BluezQt::Services::ObexObjectPush;
+    sendFile.service = BluetoothServices::ObexObjectPush;
+    sendFile.uuid = BluetoothServices::uuid(sendFile.service);
 
     Service browseFiles;
     browseFiles.name = i18n("Browse Files");
     browseFiles.icon = QStringLiteral("edit-find");
     browseFiles.mimetype = QString();
-    browseFiles.uuid = BluezQt::Services::ObexFileTransfer;
+    browseFiles.service = BluetoothServices::ObexFileTransfer;
+    browseFiles.uuid = BluetoothServices::uuid(browseFiles.service);
 
-    m_supportedServices.insert(sendFile.uuid, sendFile);
-    m_supportedServices.insert(browseFiles.uuid, browseFiles);
+    m_supportedServices.insert(sendFile.service, sendFile);
+    m_supportedServices.insert(browseFiles.service, browseFiles);
+    m_supportedServicesMask = sendFile.service | browseFiles.service;
 
     qCDebug(BLUETOOTH) << "Kio Bluetooth instanced!";
 
@@ -81,14 +92,19 @@ KioBluetooth::KioBluetooth(const QByteArray &pool, const QByteArray &app)
     }
 }
 
-QList<KioBluetooth::Service> KioBluetooth::getSupportedServices(const QStringList &uuids)
+KioBluetooth::~KioBluetooth()
 {
-    qCDebug(BLUETOOTH) << "supported services: " << uuids;
+    delete m_history;
+}
+
+QList<KioBluetooth::Service> KioBluetooth::getSupportedServices(BluetoothServices::Services services)
+{
+    qCDebug(BLUETOOTH) << "supported services: " << services;
 
     QList<Service> retValue;
-    Q_FOREACH (const QString &uuid, uuids) {
-        if (m_supportedServices.contains(uuid)) {
-            retValue << m_supportedServices[uuid];
+    Q_FOREACH (const Service &service, m_supportedServices) {
+        if (services & service.service) {
+            retValue << service;
         }
     }
     return retValue;
@@ -100,15 +116,17 @@ void KioBluetooth::listRemoteDeviceServices()
 
     qCDebug(BLUETOOTH) << "Listing remote devices";
 
-    const DeviceInfo &info = m_kded->device(m_currentHostAddress).value();
-    if (info.isEmpty()) {
+    updateDevices();
+
+    const DeviceEntry &device = m_devices.value(m_currentHostAddress);
+    if (device.address.isEmpty()) {
         qCDebug(BLUETOOTH) << "Invalid hostname!";
         infoMessage(i18n("This address is unavailable."));
         finished();
         return;
     }
 
-    const QList<Service> &services = getSupportedServices(info.value(QStringLiteral("UUIDs")).split(QLatin1Char(',')));
+    const QList<Service> &services = getSupportedServices(BluetoothServices::Services(device.services));
 
     qCDebug(BLUETOOTH) << "Num of supported services: " << services.size();
 
@@ -123,7 +141,7 @@ void KioBluetooth::listRemoteDeviceServices()
         entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, S_IRUSR | S_IRGRP | S_IROTH);
 
         // If it is browse files, act as a folder
-        if (service.uuid == BluezQt::Services::ObexFileTransfer) {
+        if (service.service == BluetoothServices::ObexFileTransfer) {
             QUrl obexUrl;
             obexUrl.setScheme(QStringLiteral("obexftp"));
             obexUrl.setHost(m_currentHostname.replace(QLatin1Char(':'), QLatin1Char('-')).toUpper());
@@ -160,35 +178,217 @@ void KioBluetooth::listDownload()
     listEntry(entry);
 }
 
+void KioBluetooth::listHistoryFolder()
+{
+    KIO::UDSEntry entry;
+    entry.fastInsert(KIO::UDSEntry::UDS_URL, QStringLiteral("bluetooth:/history"));
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, QStringLiteral("history"));
+    entry.fastInsert(KIO::UDSEntry::UDS_DISPLAY_NAME, i18n("Transfer History"));
+    entry.fastInsert(KIO::UDSEntry::UDS_ICON_NAME, QStringLiteral("view-history"));
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFDIR);
+    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, S_IRUSR | S_IRGRP | S_IROTH);
+    entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, QStringLiteral("inode/directory"));
+    listEntry(entry);
+}
+
+static KIO::UDSEntry historyFolderEntry(const QString &name, const QString &displayName, const QString &icon)
+{
+    KIO::UDSEntry entry;
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+    entry.fastInsert(KIO::UDSEntry::UDS_DISPLAY_NAME, displayName);
+    entry.fastInsert(KIO::UDSEntry::UDS_ICON_NAME, icon);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFDIR);
+    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, S_IRUSR | S_IRGRP | S_IROTH);
+    entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, QStringLiteral("inode/directory"));
+    return entry;
+}
+
+void KioBluetooth::listHistory(const QString &path)
+{
+    if (!m_history) {
+        m_history = new TransferHistory(QStringLiteral("kio_bluetooth"));
+    }
+
+    const QStringList parts = path.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+
+    // bluetooth:/history
+    if (parts.count() == 1) {
+        listEntry(historyFolderEntry(QStringLiteral("devices"), i18n("By Device"), QStringLiteral("preferences-system-bluetooth")));
+        listEntry(historyFolderEntry(QStringLiteral("days"), i18n("By Day"), QStringLiteral("view-calendar-day")));
+        finished();
+        return;
+    }
+
+    const bool byDevice = parts.at(1) == QLatin1String("devices");
+    const bool byDay = parts.at(1) == QLatin1String("days");
+
+    if ((!byDevice && !byDay) || parts.count() > 3) {
+        error(KIO::ERR_DOES_NOT_EXIST, path);
+        return;
+    }
+
+    // bluetooth:/history/devices or bluetooth:/history/days
+    if (parts.count() == 2) {
+        const QList<TransferHistory::Group> groups = byDevice ? m_history->devices() : m_history->days();
+        totalSize(groups.count());
+
+        Q_FOREACH (const TransferHistory::Group &group, groups) {
+            QString name = group.key;
+            name.replace(QLatin1Char(':'), QLatin1Char('-'));
+
+            const QString displayName = i18nc("Device name or day (number of transfers)", "%1 (%2)",
+                                              group.name.isEmpty() ? group.key : group.name, group.count);
+
+            listEntry(historyFolderEntry(name, displayName, byDevice ? QStringLiteral("preferences-system-bluetooth")
+                                                                     : QStringLiteral("view-calendar-day")));
+        }
+
+        finished();
+        return;
+    }
+
+    QList<TransferHistory::Entry> entries;
+
+    if (byDevice) {
+        QString address = parts.at(2).toUpper();
+        address.replace(QLatin1Char('-'), QLatin1Char(':'));
+        entries = m_history->entriesForDevice(address);
+    } else {
+        const QDate day = QDate::fromString(parts.at(2), Qt::ISODate);
+        if (!day.isValid()) {
+            error(KIO::ERR_DOES_NOT_EXIST, path);
+            return;
+        }
+        entries = m_history->entriesForDay(day);
+    }
+
+    QMimeDatabase mimeDatabase;
+    KFormat format;
+    totalSize(entries.count());
+
+    Q_FOREACH (const TransferHistory::Entry &transfer, entries) {
+        QString comment;
+        if (!transfer.success) {
+            comment = transfer.errorText;
+        } else if (transfer.direction == TransferHistory::Sent) {
+            comment = i18nc("Sent to device, at speed", "Sent to %1, %2/s", transfer.deviceName,
+                            format.formatByteSize(transfer.throughput()));
+        } else {
+            comment = i18nc("Received from device, at speed", "Received from %1, %2/s", transfer.deviceName,
+                            format.formatByteSize(transfer.throughput()));
+        }
+
+        const QMimeType mimeType = mimeDatabase.mimeTypeForFile(transfer.fileName, QMimeDatabase::MatchExtension);
+
+        KIO::UDSEntry entry;
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, QStringLiteral("%1-%2").arg(transfer.id).arg(transfer.fileName));
+        entry.fastInsert(KIO::UDSEntry::UDS_DISPLAY_NAME, transfer.fileName);
+        entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFREG);
+        entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, S_IRUSR | S_IRGRP | S_IROTH);
+        entry.fastInsert(KIO::UDSEntry::UDS_SIZE, transfer.size);
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, transfer.time.toSecsSinceEpoch());
+        entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, mimeType.name());
+        entry.fastInsert(KIO::UDSEntry::UDS_COMMENT, comment);
+        if (transfer.success && transfer.url.isValid()) {
+            entry.fastInsert(KIO::UDSEntry::UDS_TARGET_URL, transfer.url.toString());
+        }
+        if (!transfer.success) {
+            entry.fastInsert(KIO::UDSEntry::UDS_ICON_OVERLAY_NAMES, QStringLiteral("emblem-error"));
+        }
+        listEntry(entry);
+    }
+
+    finished();
+}
+
 void KioBluetooth::listDevices()
 {
     qCDebug(BLUETOOTH) << "Asking kded for devices";
-    const QMapDeviceInfo &devices = m_kded->allDevices().value();
-    qCDebug(BLUETOOTH) << devices.keys();
+    updateDevices();
+    qCDebug(BLUETOOTH) << m_devices.keys();
 
-    Q_FOREACH(const DeviceInfo &device, devices) {
+    Q_FOREACH (const DeviceEntry &device, m_devices) {
         listDevice(device);
     }
 
-    m_kded->startDiscovering(10 * 1000);
+    // Only devices with supported services are listed, don't look for anything else
+    QVariantMap filter;
+    filter.insert(QStringLiteral("UUIDs"), BluetoothServices::uuids(m_supportedServicesMask));
+    filter.insert(QStringLiteral("DuplicateData"), false);
+    m_kded->startFilteredDiscovering(10 * 1000, filter);
 
     infoMessage(i18n("Scanning for new devices..."));
     finished();
 }
 
-void KioBluetooth::listDevice(const DeviceInfo device)
+void KioBluetooth::updateDevices()
+{
+    const QDBusPendingReply<DeviceChanges> &reply = m_kded->devicesSince(m_devicesGeneration);
+    if (reply.isError()) {
+        qCWarning(BLUETOOTH) << "Error getting device changes" << reply.error().message();
+        updateAllDevices();
+        return;
+    }
+
+    const DeviceChanges &changes = reply.value();
+    if (changes.complete) {
+        m_devices.clear();
+    }
+
+    Q_FOREACH (const DeviceEntry &device, changes.devices) {
+        if (device.removed) {
+            m_devices.remove(device.address);
+        } else {
+            m_devices.insert(device.address, device);
+        }
+    }
+
+    qCDebug(BLUETOOTH) << "Devices updated from generation" << m_devicesGeneration << "to" << changes.generation
+                       << "changed:" << changes.devices.count();
+
+    m_devicesGeneration = changes.generation;
+}
+
+void KioBluetooth::updateAllDevices()
 {
-    qCDebug(BLUETOOTH) << device;
-    if (getSupportedServices(device[QStringLiteral("UUIDs")].split(QStringLiteral(","))).isEmpty()) {
+    // The generation is unknown now, so the next update asks for everything again
+    m_devicesGeneration = 0;
+
+    const QDBusPendingReply<QMapDeviceInfo> &reply = m_kded->allDevices();
+    if (reply.isError()) {
+        qCWarning(BLUETOOTH) << "Error getting devices" << reply.error().message();
+        return;
+    }
+
+    m_devices.clear();
+
+    Q_FOREACH (const DeviceInfo &info, reply.value()) {
+        DeviceEntry device;
+        device.address = info.value(QStringLiteral("address"));
+        device.name = info.value(QStringLiteral("name"));
+        device.icon = info.value(QStringLiteral("icon"));
+        device.uuids = info.value(QStringLiteral("UUIDs")).split(QLatin1Char(','), Qt::SkipEmptyParts);
+        device.services = info.value(QStringLiteral("Services")).toUInt();
+
+        if (!device.address.isEmpty()) {
+            m_devices.insert(device.address, device);
+        }
+    }
+}
+
+void KioBluetooth::listDevice(const DeviceEntry &device)
+{
+    qCDebug(BLUETOOTH) << device.address << device.name;
+    if (!(BluetoothServices::Services(device.services) & m_supportedServicesMask)) {
         return;
     }
     QString target = QStringLiteral("bluetooth://");
-    target.append(QString(device[QStringLiteral("address")]).replace(QLatin1Char(':'), QLatin1Char('-')));
+    target.append(QString(device.address).replace(QLatin1Char(':'), QLatin1Char('-')));
 
     KIO::UDSEntry entry;
     entry.fastInsert(KIO::UDSEntry::UDS_URL, target);
-    entry.fastInsert(KIO::UDSEntry::UDS_NAME, device[QStringLiteral("name")]);
-    entry.fastInsert(KIO::UDSEntry::UDS_ICON_NAME, device[QStringLiteral("icon")]);
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, device.name);
+    entry.fastInsert(KIO::UDSEntry::UDS_ICON_NAME, device.icon);
     entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFDIR);
     entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, S_IRUSR | S_IRGRP | S_IROTH);
     entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, QStringLiteral("inode/vnd.kde.bluedevil.device"));
@@ -199,9 +399,11 @@ void KioBluetooth::listDir(const QUrl &url)
 {
     qCDebug(BLUETOOTH) << "Listing..." << url;
 
-    // Url is not used here because all we could care about the url is the host, and that's already
-    // handled in @p setHost
-    Q_UNUSED(url);
+    // The history does not need Bluetooth to be online
+    if (!m_hasCurrentHost && url.path().startsWith(QLatin1String("/history"))) {
+        listHistory(url.path());
+        return;
+    }
 
     // If we are not online (ie. there's no working bluetooth adapter), list an empty dir
     qCDebug(BLUETOOTH) << m_kded->isOnline().value();
@@ -213,6 +415,7 @@ void KioBluetooth::listDir(const QUrl &url)
 
     if (!m_hasCurrentHost) {
         listDownload();
+        listHistoryFolder();
         listDevices();
     } else {
         listRemoteDeviceServices();
@@ -229,8 +432,9 @@ void KioBluetooth::get(const QUrl &url)
 {
     m_kded->stopDiscovering();
     qCDebug(BLUETOOTH) << "Get: " << url;
-    qCDebug(BLUETOOTH) << m_supportedServices.value(url.fileName()).mimetype;
-    mimeType(m_supportedServices.value(url.fileName()).mimetype);
+    const QString &mimetype = getSupportedServices(BluetoothServices::fromUuid(url.fileName())).value(0).mimetype;
+    qCDebug(BLUETOOTH) << mimetype;
+    mimeType(mimetype);
     finished();
 }
 
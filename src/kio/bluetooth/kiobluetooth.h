@@ -24,9 +24,11 @@
 #define KIOBLUETOOTH_H
 
 #include "kdedbluedevil.h"
+#include "../../common/bluetoothservices.h"
 
 #include <QObject>
 #include <QUrl>
+#include <QHash>
 #include <QLoggingCategory>
 
 #include <kio/slavebase.h>
@@ -36,18 +38,22 @@
  */
 class KioBluetoothPrivate;
 
+class TransferHistory;
+
 class KioBluetooth : public QObject, public KIO::SlaveBase
 {
   Q_OBJECT
 
 public:
     KioBluetooth(const QByteArray &pool, const QByteArray &app);
+    ~KioBluetooth() override;
 
     struct Service {
         QString name;
         QString icon;
         QString mimetype;
         QString uuid;
+        BluetoothServices::Service service;
     };
 
     /**
@@ -77,16 +83,28 @@ public:
     void setHost(const QString &hostname, quint16 port, const QString &user, const QString &pass) override;
 
     /**
-     * Returns a list of supported service names corresponding to the given uuids list. If an uuid is
-     * not found in the uuids list, it is not added to the list of service names.
+     * Returns a list of supported services corresponding to the given services. Services that
+     * are not supported are not added to the list.
      */
-    QList<Service> getSupportedServices(const QStringList &uuids);
+    QList<Service> getSupportedServices(BluetoothServices::Services services);
 
      /**
      * Called by @p Bluetooth::listDir to create a "Received Files" folder entry.
      */
     void listDownload();
 
+    /**
+     * Called by @p Bluetooth::listDir to create a "Transfer History" folder entry.
+     */
+    void listHistoryFolder();
+
+    /**
+     * Lists the transfer history views under bluetooth:/history. Transfers can be browsed
+     * per device (bluetooth:/history/devices/00-12-34-56-6D-34) or per day
+     * (bluetooth:/history/days/2020-05-01).
+     */
+    void listHistory(const QString &path);
+
     /**
      * Called by @p Bluetooth::listDir when listing root dir, bluetooth:/.
      */
@@ -98,8 +116,18 @@ public:
      */
     void listRemoteDeviceServices();
 
+    /**
+     * Updates @p m_devices with the devices that changed since the last update.
+     */
+    void updateDevices();
+
+    /**
+     * Replaces @p m_devices with the result of allDevices(), used when devicesSince() fails.
+     */
+    void updateAllDevices();
+
 public Q_SLOTS:
-    void listDevice(const DeviceInfo device);
+    void listDevice(const DeviceEntry &device);
 
 private:
     /**
@@ -122,15 +150,35 @@ private:
     QString m_currentHostAddress;
 
     /**
-     * This is an array containing as key the uuid and as value the name of the service that the
-     * given uuid represents, and a representative icon. It only contains the supported service names.
+     * This is an array containing as key the service and as value the name of the service, its
+     * uuid and a representative icon. It only contains the supported services.
      */
-    QMap<QString, Service> m_supportedServices;
+    QMap<BluetoothServices::Service, Service> m_supportedServices;
+
+    /**
+     * All keys of m_supportedServices
+     */
+    BluetoothServices::Services m_supportedServicesMask;
 
     /**
      * KDED DBus interface, used to communicate to the daemon since we need some status (like connected)
      */
     org::kde::BlueDevil *m_kded;
+
+    /**
+     * Devices known to kded by address, kept up to date with @p updateDevices
+     */
+    QHash<QString, DeviceEntry> m_devices;
+
+    /**
+     * Generation of the kded device table that @p m_devices corresponds to
+     */
+    quint64 m_devicesGeneration;
+
+    /**
+     * Transfer history database, opened on first use
+     */
+    TransferHistory *m_history;
 };
 
 Q_DECLARE_LOGGING_CATEGORY(BLUETOOTH)
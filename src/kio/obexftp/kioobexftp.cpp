@@ -23,10 +23,13 @@
 #include "version.h"
 #include "transferfilejob.h"
 #include "debug_p.h"
+#include "../../common/transfersize.h"
 
 #include <unistd.h>
 
+#include <QThread>
 #include <QMimeData>
+#include <QElapsedTimer>
 #include <QTemporaryFile>
 #include <QCoreApplication>
 #include <QMimeDatabase>
@@ -50,6 +53,14 @@ extern "C" int Q_DECL_EXPORT kdemain(int argc, char **argv)
     return 0;
 }
 
+// Size of the data() chunks sent by get()
+static const qint64 s_dataChunkSize = 1024 * 1024;
+
+// Downloads interrupted by link loss are retried with exponential backoff
+static const int s_maxRetries = 3;
+static const int s_firstRetryDelay = 2000;
+static const int s_linkCheckTimeout = 1000;
+
 static QString urlDirectory(const QUrl &url)
 {
     const QUrl &u = url.adjusted(QUrl::StripTrailingSlash);
@@ -177,9 +188,9 @@ void KioFtp::copy(const QUrl &src, const QUrl &dest, int permissions, KIO::JobFl
 
     qCDebug(OBEXFTP) << "copy: " << src.url() << " to " << dest.url();
 
-    copyHelper(src, dest);
-
-    finished();
+    if (copyHelper(src, dest)) {
+        finished();
+    }
 }
 
 void KioFtp::rename(const QUrl &src, const QUrl &dest, KIO::JobFlags flags)
@@ -202,19 +213,34 @@ void KioFtp::get(const QUrl &url)
     QTemporaryFile tempFile(QStringLiteral("%1/kioftp_XXXXXX.%2").arg(QDir::tempPath(), urlFileName(url)));
     tempFile.open();
 
-    copyHelper(url, QUrl::fromLocalFile(tempFile.fileName()));
+    if (!copyHelper(url, QUrl::fromLocalFile(tempFile.fileName()))) {
+        return;
+    }
 
     QMimeDatabase mimeDatabase;
     const QMimeType &mime = mimeDatabase.mimeTypeForFile(tempFile.fileName());
     mimeType(mime.name());
     qCDebug(OBEXFTP) << "Mime: " << mime.name();
 
-    totalSize(tempFile.size());
-    data(tempFile.readAll());
+    const quint64 size = tempFile.size();
+    totalSize(size);
+
+    // Pass the file on in chunks, it may be too big to be kept in memory
+    quint64 offset = 0;
+    while (offset < size) {
+        const QByteArray &chunk = tempFile.read(TransferSize::chunkLength(size, offset, s_dataChunkSize));
+        if (chunk.isEmpty()) {
+            error(KIO::ERR_CANNOT_READ, url.toDisplayString());
+            return;
+        }
+        data(chunk);
+        offset += chunk.size();
+    }
+    data(QByteArray());
     finished();
 }
 
-bool KioFtp::cancelTransfer(const QString &transfer)
+QDBusPendingReply<bool> KioFtp::cancelTransfer(const QString &transfer)
 {
     return m_kded->cancelTransfer(transfer);
 }
@@ -292,32 +318,31 @@ void KioFtp::stat(const QUrl &url)
     finished();
 }
 
-void KioFtp::copyHelper(const QUrl &src, const QUrl &dest)
+bool KioFtp::copyHelper(const QUrl &src, const QUrl &dest)
 {
     if (src.scheme() == QLatin1String("obexftp") && dest.scheme() == QLatin1String("obexftp")) {
-        copyWithinObexftp(src, dest);
-        return;
+        return copyWithinObexftp(src, dest);
     }
 
     if (src.scheme() == QLatin1String("obexftp")) {
-        copyFromObexftp(src, dest);
-        return;
+        return copyFromObexftp(src, dest);
     }
 
     if (dest.scheme() == QLatin1String("obexftp")) {
-        copyToObexftp(src, dest);
-        return;
+        return copyToObexftp(src, dest);
     }
 
     qCDebug(OBEXFTP) << "This shouldn't happen...";
+    error(KIO::ERR_UNSUPPORTED_ACTION, src.toDisplayString());
+    return false;
 }
 
-void KioFtp::copyWithinObexftp(const QUrl &src, const QUrl &dest)
+bool KioFtp::copyWithinObexftp(const QUrl &src, const QUrl &dest)
 {
     qCDebug(OBEXFTP) << "Source: " << src << "Dest:" << dest;
 
     if (!changeFolder(urlDirectory(src))) {
-        return;
+        return false;
     }
 
     BluezQt::PendingCall *call = m_transfer->copyFile(src.path(), dest.path());
@@ -330,18 +355,18 @@ void KioFtp::copyWithinObexftp(const QUrl &src, const QUrl &dest)
         } else {
             error(KIO::ERR_CANNOT_WRITE, src.path());
         }
-        return;
+        return false;
     }
 
-    finished();
+    return true;
 }
 
-void KioFtp::copyFromObexftp(const QUrl &src, const QUrl &dest)
+bool KioFtp::copyFromObexftp(const QUrl &src, const QUrl &dest)
 {
     qCDebug(OBEXFTP) << "Source: " << src << "Dest:" << dest;
 
     if (!changeFolder(urlDirectory(src))) {
-        return;
+        return false;
     }
 
     if (!m_statMap.contains(src.toDisplayString())) {
@@ -349,34 +374,141 @@ void KioFtp::copyFromObexftp(const QUrl &src, const QUrl &dest)
         listFolder(urlUpDir(src), &ok);
     }
 
-    BluezQt::PendingCall *call = m_transfer->getFile(dest.path(), urlFileName(src));
-    call->waitForFinished();
-
-    int size = m_statMap.value(src.toDisplayString()).numberValue(KIO::UDSEntry::UDS_SIZE);
+    const KIO::filesize_t size = m_statMap.value(src.toDisplayString()).numberValue(KIO::UDSEntry::UDS_SIZE);
     totalSize(size);
 
-    BluezQt::ObexTransferPtr transfer = call->value().value<BluezQt::ObexTransferPtr>();
-    TransferFileJob *getFile = new TransferFileJob(transfer, this);
-    getFile->exec();
+    // obexd can't resume downloads, so when the link is lost the file is
+    // downloaded again from the start after reconnecting
+    KIO::filesize_t wastedBytes = 0;
+    int retryDelay = s_firstRetryDelay;
+
+    for (int attempt = 0;; ++attempt) {
+        BluezQt::PendingCall *call = m_transfer->getFile(dest.path(), urlFileName(src));
+        call->waitForFinished();
+
+        if (call->error()) {
+            error(KIO::ERR_CANNOT_READ, src.path());
+            return false;
+        }
+
+        BluezQt::ObexTransferPtr transfer = call->value().value<BluezQt::ObexTransferPtr>();
+        TransferFileJob *getFile = new TransferFileJob(transfer, this);
+        getFile->setDownloadTarget(dest.path(), size);
+
+        if (getFile->exec()) {
+            break;
+        }
+
+        // Only a dropped link is worth retrying, other errors would just fail again
+        if (getFile->error() == KIO::ERR_USER_CANCELED || attempt == s_maxRetries || !isLinkLost()) {
+            setMetaData(QStringLiteral("obexftp-wasted-bytes"), QString::number(wastedBytes + getFile->transferredBytes()));
+            transferError(getFile, src);
+            return false;
+        }
+
+        wastedBytes += getFile->transferredBytes();
+        qCDebug(OBEXFTP) << "Download failed, retrying in" << retryDelay << "ms, wasted" << wastedBytes << "bytes";
+        infoMessage(i18n("Connection lost, retrying..."));
+
+        if (!waitForRetry(retryDelay)) {
+            error(KIO::ERR_USER_CANCELED, src.toDisplayString());
+            return false;
+        }
+        retryDelay *= 2;
+
+        connectToHost();
+        if (!m_transfer) {
+            error(KIO::ERR_CANNOT_CONNECT, m_host);
+            return false;
+        }
+
+        if (!changeFolder(urlDirectory(src))) {
+            return false;
+        }
+
+        processedSize(0);
+    }
+
+    setMetaData(QStringLiteral("obexftp-wasted-bytes"), QString::number(wastedBytes));
+    return true;
 }
 
-void KioFtp::copyToObexftp(const QUrl &src, const QUrl &dest)
+bool KioFtp::waitForRetry(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    while (timer.elapsed() < msecs) {
+        if (wasKilled()) {
+            return false;
+        }
+        QThread::msleep(20);
+    }
+
+    return !wasKilled();
+}
+
+bool KioFtp::isLinkLost()
+{
+    // obexd reports the failed transfer before kded learns about the
+    // disconnect, so give it a moment to catch up
+    QElapsedTimer timer;
+    timer.start();
+
+    do {
+        QDBusPendingReply<bool> reply = m_kded->isConnected(m_host);
+        reply.waitForFinished();
+
+        if (reply.isError() || !reply.value()) {
+            return true;
+        }
+        QThread::msleep(100);
+    } while (timer.elapsed() < s_linkCheckTimeout);
+
+    return false;
+}
+
+bool KioFtp::copyToObexftp(const QUrl &src, const QUrl &dest)
 {
     qCDebug(OBEXFTP) << "Source:" << src << "Dest:" << dest;
 
     if (!changeFolder(urlDirectory(dest))) {
-        return;
+        return false;
     }
 
     BluezQt::PendingCall *call = m_transfer->putFile(src.path(), urlFileName(dest));
     call->waitForFinished();
 
-    int size = QFile(src.path()).size();
+    if (call->error()) {
+        error(KIO::ERR_CANNOT_WRITE, dest.path());
+        return false;
+    }
+
+    const KIO::filesize_t size = QFile(src.path()).size();
     totalSize(size);
 
     BluezQt::ObexTransferPtr transfer = call->value().value<BluezQt::ObexTransferPtr>();
     TransferFileJob *putFile = new TransferFileJob(transfer, this);
-    putFile->exec();
+    return runTransferJob(putFile, dest);
+}
+
+bool KioFtp::runTransferJob(TransferFileJob *job, const QUrl &url)
+{
+    if (job->exec()) {
+        return true;
+    }
+
+    transferError(job, url);
+    return false;
+}
+
+void KioFtp::transferError(TransferFileJob *job, const QUrl &url)
+{
+    if (job->error() == KIO::ERR_USER_CANCELED) {
+        error(KIO::ERR_USER_CANCELED, url.toDisplayString());
+    } else {
+        error(KIO::ERR_SLAVE_DEFINED, job->errorText());
+    }
 }
 
 void KioFtp::statHelper(const QUrl &url)
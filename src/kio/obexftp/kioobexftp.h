@@ -32,6 +32,8 @@
 
 #include <BluezQt/ObexFileTransfer>
 
+class TransferFileJob;
+
 class KioFtp : public QObject, public KIO::SlaveBase
 {
     Q_OBJECT
@@ -48,17 +50,21 @@ public:
     void rename(const QUrl &src, const QUrl &dest, KIO::JobFlags flags) override;
     void get(const QUrl &url) override;
 
-    bool cancelTransfer(const QString &transfer);
+    QDBusPendingReply<bool> cancelTransfer(const QString &transfer);
 
 private:
-    void copyHelper(const QUrl &src, const QUrl &dest);
-    void copyWithinObexftp(const QUrl &src, const QUrl &dest);
-    void copyFromObexftp(const QUrl &src, const QUrl &dest);
-    void copyToObexftp(const QUrl &src, const QUrl &dest);
+    bool copyHelper(const QUrl &src, const QUrl &dest);
+    bool copyWithinObexftp(const QUrl &src, const QUrl &dest);
+    bool copyFromObexftp(const QUrl &src, const QUrl &dest);
+    bool copyToObexftp(const QUrl &src, const QUrl &dest);
     void statHelper(const QUrl &url);
 
     QList<KIO::UDSEntry> listFolder(const QUrl &url, bool *ok);
     bool changeFolder(const QString &folder);
+    bool runTransferJob(TransferFileJob *job, const QUrl &url);
+    void transferError(TransferFileJob *job, const QUrl &url);
+    bool waitForRetry(int msecs);
+    bool isLinkLost();
     bool createFolder(const QString &folder);
     bool deleteFile(const QString &file);
 
@@ -19,17 +19,36 @@
 #include "transferfilejob.h"
 #include "kioobexftp.h"
 #include "debug_p.h"
+#include "../../common/fileallocation.h"
+#include "../../common/transfersize.h"
 
+#include <QFile>
+#include <QDBusPendingCallWatcher>
+
+#include <KIO/Global>
 #include <KLocalizedString>
 
 #include <BluezQt/PendingCall>
 
+// How often to check whether the slave was killed, progress updates
+// don't arrive when the link has stalled
+static const int s_killCheckInterval = 20;
+
+// How long to wait for obexd to confirm the cancellation
+static const int s_cancelTimeout = 60;
+
 TransferFileJob::TransferFileJob(BluezQt::ObexTransferPtr transfer, KioFtp *parent)
     : KJob(parent)
+    , m_cancelling(false)
+    , m_cancelled(false)
     , m_speedBytes(0)
+    , m_transferred(0)
+    , m_downloadSize(0)
     , m_parent(parent)
     , m_transfer(transfer)
 {
+    m_killTimer.setInterval(s_killCheckInterval);
+    connect(&m_killTimer, &QTimer::timeout, this, &TransferFileJob::checkKilled);
 }
 
 void TransferFileJob::start()
@@ -37,10 +56,30 @@ void TransferFileJob::start()
     QMetaObject::invokeMethod(this, "doStart", Qt::QueuedConnection);
 }
 
+void TransferFileJob::setDownloadTarget(const QString &filePath, quint64 size)
+{
+    m_downloadPath = filePath;
+    m_downloadSize = size;
+}
+
+quint64 TransferFileJob::transferredBytes() const
+{
+    return m_transferred;
+}
+
 void TransferFileJob::doStart()
 {
     connect(m_transfer.data(), &BluezQt::ObexTransfer::statusChanged, this, &TransferFileJob::statusChanged);
     connect(m_transfer.data(), &BluezQt::ObexTransfer::transferredChanged, this, &TransferFileJob::transferredChanged);
+
+    m_killTimer.start();
+}
+
+void TransferFileJob::checkKilled()
+{
+    if (m_parent->wasKilled()) {
+        cancel();
+    }
 }
 
 void TransferFileJob::statusChanged(BluezQt::ObexTransfer::Status status)
@@ -48,16 +87,27 @@ void TransferFileJob::statusChanged(BluezQt::ObexTransfer::Status status)
     switch (status) {
     case BluezQt::ObexTransfer::Active:
         qCDebug(OBEXFTP) << "Transfer Active";
-        m_time = QTime::currentTime();
+        m_time.start();
+
+        // obexd truncates the file when opening it, so this can only be done now
+        if (!m_downloadPath.isEmpty()) {
+            QString errorString;
+            if (!preallocateFile(m_downloadPath, m_downloadSize, &errorString)) {
+                qCDebug(OBEXFTP) << "Preallocating" << m_downloadPath << "failed:" << errorString;
+            }
+        }
         break;
 
     case BluezQt::ObexTransfer::Complete:
         qCDebug(OBEXFTP) << "Transfer Complete";
+        m_killTimer.stop();
         emitResult();
         break;
 
     case BluezQt::ObexTransfer::Error:
         qCDebug(OBEXFTP) << "Transfer Error";
+        m_killTimer.stop();
+        removeDownloadTarget();
         setError(KJob::UserDefinedError);
         setErrorText(i18n("Bluetooth transfer failed"));
         emitResult();
@@ -74,21 +124,77 @@ void TransferFileJob::transferredChanged(quint64 transferred)
     // qCDebug(OBEXFTP) << "Transferred: " << transferred;
 
     if (m_parent->wasKilled()) {
-        qCDebug(OBEXFTP) << "Kio was killed, aborting task";
-        m_parent->cancelTransfer(m_transfer->objectPath().path());
-        emitResult();
+        cancel();
         return;
     }
 
+    m_transferred = transferred;
+
     // If at least 1 second has passed since last update
-    int secondsSinceLastTime = m_time.secsTo(QTime::currentTime());
-    if (secondsSinceLastTime > 0) {
-        float speed = (transferred - m_speedBytes) / secondsSinceLastTime;
+    const qint64 msecsSinceLastTime = m_time.elapsed();
+    if (msecsSinceLastTime >= 1000) {
+        const quint64 speed = TransferSize::speed(transferred - m_speedBytes, msecsSinceLastTime);
 
         m_parent->speed(speed);
-        m_time = QTime::currentTime();
+        m_time.restart();
         m_speedBytes = transferred;
     }
 
     m_parent->processedSize(transferred);
 }
+
+void TransferFileJob::cancel()
+{
+    if (m_cancelling) {
+        return;
+    }
+
+    qCDebug(OBEXFTP) << "Kio was killed, aborting task";
+
+    m_cancelling = true;
+    m_cancelTime.start();
+    m_killTimer.stop();
+
+    // Ignore the Error status obexd reports for the cancelled transfer
+    disconnect(m_transfer.data(), nullptr, this, nullptr);
+
+    // Don't block on the reply, a stalled link may delay it for a long time
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(m_parent->cancelTransfer(m_transfer->objectPath().path()), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, &TransferFileJob::cancelTransferFinished);
+
+    QTimer::singleShot(s_cancelTimeout, this, &TransferFileJob::cancelFinished);
+}
+
+void TransferFileJob::cancelTransferFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    if (watcher->isError()) {
+        qCWarning(OBEXFTP) << "Cancelling transfer failed:" << watcher->error().message();
+    }
+
+    cancelFinished();
+}
+
+void TransferFileJob::cancelFinished()
+{
+    // Called by either the reply or the timeout, whichever comes first
+    if (m_cancelled) {
+        return;
+    }
+    m_cancelled = true;
+
+    removeDownloadTarget();
+
+    qCDebug(OBEXFTP) << "Transfer cancelled in" << m_cancelTime.elapsed() << "ms";
+
+    setError(KIO::ERR_USER_CANCELED);
+    emitResult();
+}
+
+void TransferFileJob::removeDownloadTarget()
+{
+    if (!m_downloadPath.isEmpty()) {
+        QFile::remove(m_downloadPath);
+    }
+}
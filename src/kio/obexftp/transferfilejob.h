@@ -19,12 +19,15 @@
 #ifndef TRANSFERFILEJOB_H
 #define TRANSFERFILEJOB_H
 
-#include <QTime>
+#include <QTimer>
+#include <QElapsedTimer>
 
 #include <KJob>
 
 #include <BluezQt/ObexTransfer>
 
+class QDBusPendingCallWatcher;
+
 class KioFtp;
 
 class TransferFileJob : public KJob
@@ -36,14 +39,37 @@ public:
 
     void start() override;
 
+    /**
+     * Sets the local file obexd receives into. @p size bytes are reserved for it
+     * once the transfer is active, and it is removed when the transfer fails or
+     * is cancelled.
+     */
+    void setDownloadTarget(const QString &filePath, quint64 size);
+
+    // Bytes transferred before the job finished
+    quint64 transferredBytes() const;
+
 private Q_SLOTS:
     void doStart();
+    void checkKilled();
     void statusChanged(BluezQt::ObexTransfer::Status status);
     void transferredChanged(quint64 transferred);
+    void cancelTransferFinished(QDBusPendingCallWatcher *watcher);
+    void cancelFinished();
 
 private:
-    QTime m_time;
-    qlonglong m_speedBytes;
+    void cancel();
+    void removeDownloadTarget();
+
+    QElapsedTimer m_time;
+    QElapsedTimer m_cancelTime;
+    QTimer m_killTimer;
+    bool m_cancelling;
+    bool m_cancelled;
+    quint64 m_speedBytes;
+    quint64 m_transferred;
+    QString m_downloadPath;
+    quint64 m_downloadSize;
     KioFtp *m_parent;
     BluezQt::ObexTransferPtr m_transfer;
 };
@@ -23,6 +23,9 @@
 #include "discoverwidget.h"
 #include "ui_discover.h"
 #include "debug_p.h"
+#include "kdedbluedevil.h"
+#include "../common/deviceschangedwatcher.h"
+#include "../common/deviceservicescache.h"
 
 #include <QAction>
 #include <QSortFilterProxyModel>
@@ -54,19 +57,23 @@ public:
 
 private:
     BluezQt::DevicesModel *m_devicesModel;
+    DeviceServicesCache *m_servicesCache;
 };
 
 DevicesProxyModel::DevicesProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
     , m_devicesModel(nullptr)
+    , m_servicesCache(new DeviceServicesCache(this))
 {
-    setDynamicSortFilter(true);
+    // Sorted and filtered again on batched changes from DevicesChangedWatcher
+    setDynamicSortFilter(false);
     sort(0, Qt::DescendingOrder);
 }
 
 void DevicesProxyModel::setDevicesModel(BluezQt::DevicesModel *model)
 {
     m_devicesModel = model;
+    m_servicesCache->setModel(model);
     setSourceModel(model);
 }
 
@@ -85,10 +92,9 @@ bool DevicesProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourc
 {
     QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
 
-    const QStringList &uuids = index.data(BluezQt::DevicesModel::UuidsRole).toStringList();
     bool adapterPowered = index.data(BluezQt::DevicesModel::AdapterPoweredRole).toBool();
 
-    return adapterPowered && uuids.contains(BluezQt::Services::ObexObjectPush);
+    return adapterPowered && (m_servicesCache->services(index) & BluetoothServices::ObexObjectPush);
 }
 
 BluezQt::DevicePtr DevicesProxyModel::device(const QModelIndex &index) const
@@ -108,6 +114,21 @@ DiscoverWidget::DiscoverWidget(BluezQt::Manager *manager, QWidget* parent)
     m_model->setDevicesModel(new BluezQt::DevicesModel(m_manager, this));
     devices->setModel(m_model);
 
+    DevicesChangedWatcher *watcher = new DevicesChangedWatcher(m_manager, this);
+    connect(watcher, &DevicesChangedWatcher::devicesChanged, m_model, &QSortFilterProxyModel::invalidate);
+    connect(m_manager, &BluezQt::Manager::adapterChanged, m_model, &QSortFilterProxyModel::invalidate);
+
+    // Only look for devices that can receive files, so that the model isn't
+    // flooded with LE beacons and RSSI updates in crowded places
+    QVariantMap filter;
+    filter.insert(QStringLiteral("Transport"), QStringLiteral("bredr"));
+    filter.insert(QStringLiteral("UUIDs"), QStringList(BluezQt::Services::ObexObjectPush));
+    filter.insert(QStringLiteral("DuplicateData"), false);
+
+    m_kded = new OrgKdeBlueDevilInterface(QStringLiteral("org.kde.kded5"), QStringLiteral("/modules/bluedevil"),
+                                          QDBusConnection::sessionBus(), this);
+    m_kded->startFilteredDiscovering(0, filter);
+
     checkAdapters();
     connect(m_manager, &BluezQt::Manager::adapterAdded, this, &DiscoverWidget::checkAdapters);
     connect(m_manager, &BluezQt::Manager::adapterChanged, this, &DiscoverWidget::checkAdapters);
@@ -115,6 +136,17 @@ DiscoverWidget::DiscoverWidget(BluezQt::Manager *manager, QWidget* parent)
     connect(m_manager, &BluezQt::Manager::bluetoothBlockedChanged, this, &DiscoverWidget::checkAdapters);
 
     connect(devices->selectionModel(), &QItemSelectionModel::currentChanged, this, &DiscoverWidget::indexSelected);
+    connect(devices->selectionModel(), &QItemSelectionModel::selectionChanged, this, &DiscoverWidget::selectionChanged);
+}
+
+DiscoverWidget::~DiscoverWidget()
+{
+    m_kded->stopDiscovering();
+}
+
+void DiscoverWidget::setSelectionMode(QAbstractItemView::SelectionMode mode)
+{
+    devices->setSelectionMode(mode);
 }
 
 void DiscoverWidget::indexSelected(const QModelIndex index)
@@ -122,6 +154,20 @@ void DiscoverWidget::indexSelected(const QModelIndex index)
     Q_EMIT deviceSelected(m_model->device(index));
 }
 
+void DiscoverWidget::selectionChanged()
+{
+    QList<BluezQt::DevicePtr> selectedDevices;
+
+    Q_FOREACH (const QModelIndex &index, devices->selectionModel()->selectedIndexes()) {
+        BluezQt::DevicePtr device = m_model->device(index);
+        if (device) {
+            selectedDevices.append(device);
+        }
+    }
+
+    Q_EMIT devicesSelected(selectedDevices);
+}
+
 void DiscoverWidget::checkAdapters()
 {
     bool error = false;
@@ -26,11 +26,14 @@
 #include "ui_discover.h"
 
 #include <QWidget>
+#include <QAbstractItemView>
 
 #include <BluezQt/Types>
 
 class KMessageWidget;
 
+class OrgKdeBlueDevilInterface;
+
 class DevicesProxyModel;
 
 class DiscoverWidget : public QWidget, public Ui::Discover
@@ -39,12 +42,17 @@ class DiscoverWidget : public QWidget, public Ui::Discover
 
 public:
     explicit DiscoverWidget(BluezQt::Manager *manager, QWidget *parent = nullptr);
+    ~DiscoverWidget() override;
+
+    void setSelectionMode(QAbstractItemView::SelectionMode mode);
 
 Q_SIGNALS:
     void deviceSelected(BluezQt::DevicePtr device);
+    void devicesSelected(const QList<BluezQt::DevicePtr> &devices);
 
 private Q_SLOTS:
     void indexSelected(const QModelIndex index);
+    void selectionChanged();
 
     void checkAdapters();
     void fixAdaptersError();
@@ -53,6 +61,7 @@ private:
     BluezQt::Manager *m_manager;
     DevicesProxyModel *m_model;
     KMessageWidget *m_warningWidget;
+    OrgKdeBlueDevilInterface *m_kded;
 };
 
 #endif // DISCOVERWIDGET_H
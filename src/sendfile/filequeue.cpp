@@ -0,0 +1,233 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "filequeue.h"
+#include "filetranscoder.h"
+#include "debug_p.h"
+
+#include <QFile>
+#include <QThread>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QElapsedTimer>
+
+#include <fcntl.h>
+
+static void prefetchFile(const QString &filePath)
+{
+#ifdef POSIX_FADV_WILLNEED
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        posix_fadvise(file.handle(), 0, 0, POSIX_FADV_WILLNEED);
+    }
+#else
+    Q_UNUSED(filePath)
+#endif
+}
+
+FileQueue::FileQueue(const QStringList &paths, QObject *parent)
+    : QObject(parent)
+    , m_paths(paths)
+    , m_totalSize(0)
+    , m_finished(false)
+    , m_prefetch(false)
+    , m_thread(nullptr)
+    , m_cancelled(0)
+    , m_transcoder(nullptr)
+{
+}
+
+FileQueue::~FileQueue()
+{
+    if (m_thread) {
+        m_cancelled.storeRelaxed(1);
+        m_thread->wait();
+    }
+}
+
+void FileQueue::setTranscoder(FileTranscoder *transcoder)
+{
+    m_transcoder = transcoder;
+    connect(m_transcoder, &FileTranscoder::fileTranscoded, this, &FileQueue::fileTranscoded);
+}
+
+void FileQueue::setPrefetch(bool prefetch)
+{
+    m_prefetch = prefetch;
+}
+
+void FileQueue::start()
+{
+    const QStringList paths = m_paths;
+    const bool prefetch = m_prefetch;
+
+    m_thread = QThread::create([this, paths, prefetch]() {
+        QStringList files;
+        QVector<quint64> sizes;
+        QElapsedTimer timer;
+        timer.start();
+
+        // The first file is delivered right away so that sending can start,
+        // the rest in batches to not flood the event loop
+        auto flush = [&]() {
+            if (files.isEmpty()) {
+                return;
+            }
+            QMetaObject::invokeMethod(this, [this, files, sizes]() {
+                addFiles(files, sizes);
+            }, Qt::QueuedConnection);
+            files.clear();
+            sizes.clear();
+            timer.restart();
+        };
+
+        bool first = true;
+        auto add = [&](const QFileInfo &info) {
+            files.append(info.absoluteFilePath());
+            sizes.append(info.size());
+            if (prefetch) {
+                prefetchFile(info.absoluteFilePath());
+            }
+            if (first || files.count() >= 100 || timer.elapsed() > 100) {
+                flush();
+                first = false;
+            }
+        };
+
+        Q_FOREACH (const QString &path, paths) {
+            if (m_cancelled.loadRelaxed()) {
+                return;
+            }
+
+            const QFileInfo info(path);
+
+            if (info.isDir()) {
+                QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+                while (it.hasNext() && !m_cancelled.loadRelaxed()) {
+                    it.next();
+                    add(it.fileInfo());
+                }
+            } else if (info.isFile()) {
+                add(info);
+            } else {
+                qCWarning(SENDFILE) << "Skipping" << path;
+            }
+        }
+
+        flush();
+
+        QMetaObject::invokeMethod(this, [this]() {
+            scanFinished();
+        }, Qt::QueuedConnection);
+    });
+
+    m_thread->setParent(this);
+    m_thread->start();
+}
+
+bool FileQueue::isFinished() const
+{
+    return m_finished;
+}
+
+int FileQueue::count() const
+{
+    return m_entries.count();
+}
+
+bool FileQueue::isReady(int index) const
+{
+    return index < m_entries.count() && m_entries.at(index).ready;
+}
+
+QString FileQueue::fileName(int index) const
+{
+    return m_entries.at(index).path;
+}
+
+QString FileQueue::file(int index) const
+{
+    return m_entries.at(index).file;
+}
+
+quint64 FileQueue::fileSize(int index) const
+{
+    return m_entries.at(index).size;
+}
+
+quint64 FileQueue::totalSize() const
+{
+    return m_totalSize;
+}
+
+void FileQueue::addFiles(const QStringList &paths, const QVector<quint64> &sizes)
+{
+    const int first = m_entries.count();
+
+    for (int i = 0; i < paths.count(); ++i) {
+        Entry entry;
+        entry.path = paths.at(i);
+        entry.file = entry.path;
+        entry.size = sizes.at(i);
+        m_entries.append(entry);
+        m_totalSize += entry.size;
+    }
+
+    Q_EMIT totalSizeChanged(m_totalSize);
+
+    for (int index = first; index < m_entries.count(); ++index) {
+        Q_EMIT fileAdded(index);
+
+        if (m_transcoder) {
+            m_transcoder->transcode(index, m_entries.at(index).path);
+        } else {
+            setReady(index);
+        }
+    }
+}
+
+void FileQueue::scanFinished()
+{
+    qCDebug(SENDFILE) << "Found" << m_entries.count() << "files," << m_totalSize << "bytes";
+
+    m_finished = true;
+    Q_EMIT finished();
+}
+
+void FileQueue::fileTranscoded(int index, const QString &path, quint64 size)
+{
+    Entry &entry = m_entries[index];
+
+    if (entry.size != size) {
+        m_totalSize = m_totalSize - entry.size + size;
+        entry.size = size;
+        Q_EMIT totalSizeChanged(m_totalSize);
+    }
+
+    entry.file = path;
+    setReady(index);
+}
+
+void FileQueue::setReady(int index)
+{
+    m_entries[index].ready = true;
+    Q_EMIT fileReady(index);
+}
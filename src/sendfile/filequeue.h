@@ -0,0 +1,103 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef FILEQUEUE_H
+#define FILEQUEUE_H
+
+#include <QObject>
+#include <QVector>
+#include <QAtomicInt>
+#include <QStringList>
+
+class QThread;
+
+class FileTranscoder;
+
+/**
+ * List of files to be sent, filled asynchronously.
+ *
+ * Scanning, sizing and expanding directories is done on a worker thread, so
+ * that huge selections or files on network mounts don't block the GUI. Jobs
+ * can start sending as soon as the first file is ready, while the total size
+ * keeps growing until the queue is finished.
+ *
+ * When a FileTranscoder is set, files are only ready after it prepared them.
+ */
+class FileQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileQueue(const QStringList &paths, QObject *parent = nullptr);
+    ~FileQueue() override;
+
+    void setTranscoder(FileTranscoder *transcoder);
+    void setPrefetch(bool prefetch);
+
+    void start();
+
+    // All files are known
+    bool isFinished() const;
+
+    int count() const;
+    bool isReady(int index) const;
+
+    // Path of the file as selected by the user
+    QString fileName(int index) const;
+
+    // Path of the file that should be sent (transcoded file, if any)
+    QString file(int index) const;
+    quint64 fileSize(int index) const;
+
+    quint64 totalSize() const;
+
+Q_SIGNALS:
+    void fileAdded(int index);
+    void fileReady(int index);
+    void totalSizeChanged(quint64 size);
+    void finished();
+
+private:
+    struct Entry
+    {
+        QString path;
+        QString file;
+        quint64 size = 0;
+        bool ready = false;
+    };
+
+    void addFiles(const QStringList &paths, const QVector<quint64> &sizes);
+    void scanFinished();
+    void fileTranscoded(int index, const QString &path, quint64 size);
+    void setReady(int index);
+
+    QStringList m_paths;
+    QVector<Entry> m_entries;
+    quint64 m_totalSize;
+    bool m_finished;
+    bool m_prefetch;
+
+    QThread *m_thread;
+    QAtomicInt m_cancelled;
+    FileTranscoder *m_transcoder;
+};
+
+#endif // FILEQUEUE_H
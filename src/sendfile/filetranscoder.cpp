@@ -0,0 +1,168 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "filetranscoder.h"
+#include "debug_p.h"
+
+#include <QDir>
+#include <QPair>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+// Returns path of the transcoded file, or the original path if it should be sent unchanged
+static QString transcodeImage(const QString &filePath, const QString &outputDir, int maxSize, int quality, qint64 maxFileSize)
+{
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+
+    const QByteArray format = reader.format();
+    if (format != "jpeg" && format != "png") {
+        return filePath;
+    }
+
+    const qint64 originalSize = QFileInfo(filePath).size();
+    const QSize size = reader.size();
+    const bool tooLarge = maxSize > 0 && size.isValid() && qMax(size.width(), size.height()) > maxSize;
+    const bool overBudget = maxFileSize > 0 && originalSize > maxFileSize;
+
+    if (!tooLarge && !overBudget) {
+        return filePath;
+    }
+
+    if (tooLarge) {
+        // Lets the decoder skip most of the work for large photos
+        reader.setScaledSize(size.scaled(maxSize, maxSize, Qt::KeepAspectRatio));
+    }
+
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qCWarning(SENDFILE) << "Error reading image" << filePath << reader.errorString();
+        return filePath;
+    }
+
+    if (!QDir().mkpath(outputDir)) {
+        return filePath;
+    }
+
+    const QString outputPath = outputDir + QLatin1Char('/') + QFileInfo(filePath).fileName();
+
+    // Lower the quality step by step until the file fits into the size budget
+    for (int q = quality; ; q -= 15) {
+        QImageWriter writer(outputPath, format);
+        writer.setQuality(q);
+
+        if (!writer.write(image)) {
+            qCWarning(SENDFILE) << "Error writing image" << outputPath << writer.errorString();
+            QFile::remove(outputPath);
+            return filePath;
+        }
+
+        const qint64 outputSize = QFileInfo(outputPath).size();
+        if (maxFileSize <= 0 || outputSize <= maxFileSize || format != "jpeg" || q <= 30) {
+            break;
+        }
+    }
+
+    if (QFileInfo(outputPath).size() >= originalSize) {
+        QFile::remove(outputPath);
+        return filePath;
+    }
+
+    return outputPath;
+}
+
+FileTranscoder::FileTranscoder(QObject *parent)
+    : QObject(parent)
+    , m_maxImageSize(0)
+    , m_imageQuality(85)
+    , m_maxFileSize(0)
+{
+}
+
+FileTranscoder::~FileTranscoder()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+int FileTranscoder::maximumImageSize() const
+{
+    return m_maxImageSize;
+}
+
+void FileTranscoder::setMaximumImageSize(int size)
+{
+    m_maxImageSize = size;
+}
+
+int FileTranscoder::imageQuality() const
+{
+    return m_imageQuality;
+}
+
+void FileTranscoder::setImageQuality(int quality)
+{
+    m_imageQuality = qBound(0, quality, 100);
+}
+
+qint64 FileTranscoder::maximumFileSize() const
+{
+    return m_maxFileSize;
+}
+
+void FileTranscoder::setMaximumFileSize(qint64 size)
+{
+    m_maxFileSize = size;
+}
+
+void FileTranscoder::transcode(int index, const QString &filePath)
+{
+    if (!m_dir.isValid() || (m_maxImageSize <= 0 && m_maxFileSize <= 0)) {
+        Q_EMIT fileTranscoded(index, filePath, QFileInfo(filePath).size());
+        return;
+    }
+
+    // Every file gets its own directory so that the original file names can be kept
+    const QString outputDir = m_dir.path() + QLatin1Char('/') + QString::number(index);
+    const int maxImageSize = m_maxImageSize;
+    const int imageQuality = m_imageQuality;
+    const qint64 maxFileSize = m_maxFileSize;
+
+    typedef QPair<QString, quint64> Result;
+
+    QFutureWatcher<Result> *watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, &QFutureWatcher<Result>::finished, this, [this, watcher, index, filePath]() {
+        const Result result = watcher->result();
+        if (result.first != filePath) {
+            qCDebug(SENDFILE) << "Transcoded" << filePath << "to" << result.second << "bytes";
+        }
+        Q_EMIT fileTranscoded(index, result.first, result.second);
+        watcher->deleteLater();
+    });
+
+    watcher->setFuture(QtConcurrent::run(&m_pool, [=]() {
+        const QString path = transcodeImage(filePath, outputDir, maxImageSize, imageQuality, maxFileSize);
+        return Result(path, QFileInfo(path).size());
+    }));
+}
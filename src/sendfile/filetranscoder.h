@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef FILETRANSCODER_H
+#define FILETRANSCODER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTemporaryDir>
+
+/**
+ * Prepares files for sending by scaling down and recompressing images.
+ *
+ * Files are processed on a thread pool that uses all cores. fileTranscoded()
+ * is emitted for every file once it can be sent, so a job can start sending
+ * the first file while the following ones are still being processed. Files
+ * that are not images, or would not get smaller, are sent unchanged.
+ */
+class FileTranscoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileTranscoder(QObject *parent = nullptr);
+    ~FileTranscoder() override;
+
+    int maximumImageSize() const;
+    void setMaximumImageSize(int size);
+
+    int imageQuality() const;
+    void setImageQuality(int quality);
+
+    qint64 maximumFileSize() const;
+    void setMaximumFileSize(qint64 size);
+
+    // Index is only used to identify the file in fileTranscoded()
+    void transcode(int index, const QString &filePath);
+
+Q_SIGNALS:
+    void fileTranscoded(int index, const QString &filePath, quint64 size);
+
+private:
+    int m_maxImageSize;
+    int m_imageQuality;
+    qint64 m_maxFileSize;
+
+    QTemporaryDir m_dir;
+    QThreadPool m_pool;
+};
+
+#endif // FILETRANSCODER_H
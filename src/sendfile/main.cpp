@@ -61,13 +61,35 @@ int main(int argc, char *argv[])
     ubiOption.setValueName(QStringLiteral("ubi"));
 
     QCommandLineOption filesOption(QStringList() << QStringLiteral("files") << QStringLiteral("f"));
-    filesOption.setDescription(i18n("Files to be sent."));
+    filesOption.setDescription(i18n("Files or folders to be sent."));
     filesOption.setValueName(QStringLiteral("files"));
 
+    QCommandLineOption transfersOption(QStringList() << QStringLiteral("max-transfers"));
+    transfersOption.setDescription(i18n("Maximum number of devices to send files to at the same time."));
+    transfersOption.setValueName(QStringLiteral("count"));
+    transfersOption.setDefaultValue(QStringLiteral("3"));
+
+    QCommandLineOption scaleOption(QStringList() << QStringLiteral("scale-images"));
+    scaleOption.setDescription(i18n("Scale down images larger than the given width or height before sending."));
+    scaleOption.setValueName(QStringLiteral("pixels"));
+
+    QCommandLineOption qualityOption(QStringList() << QStringLiteral("image-quality"));
+    qualityOption.setDescription(i18n("Quality (0-100) used when recompressing images."));
+    qualityOption.setValueName(QStringLiteral("quality"));
+    qualityOption.setDefaultValue(QStringLiteral("85"));
+
+    QCommandLineOption imageSizeOption(QStringList() << QStringLiteral("max-image-size"));
+    imageSizeOption.setDescription(i18n("Recompress images larger than the given size in KiB before sending."));
+    imageSizeOption.setValueName(QStringLiteral("KiB"));
+
     QCommandLineParser parser;
     parser.addOption(kioOption);
     parser.addOption(ubiOption);
     parser.addOption(filesOption);
+    parser.addOption(transfersOption);
+    parser.addOption(scaleOption);
+    parser.addOption(qualityOption);
+    parser.addOption(imageSizeOption);
     aboutData.setupCommandLine(&parser);
 
     parser.process(app);
@@ -79,6 +101,10 @@ int main(int argc, char *argv[])
     }
 
     SendFileWizard *wizard = new SendFileWizard(deviceInfo, parser.values(filesOption));
+    wizard->setMaximumConcurrentTransfers(parser.value(transfersOption).toInt());
+    wizard->setImageScaling(parser.value(scaleOption).toInt(),
+                            parser.value(qualityOption).toInt(),
+                            parser.value(imageSizeOption).toLongLong() * 1024);
 
     QObject::connect(&service, &KDBusService::activateRequested, wizard, [wizard]() {
         wizard->setWindowState((wizard->windowState() & ~Qt::WindowMinimized) | Qt::WindowActive);
@@ -0,0 +1,319 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#include "multisendfilesjob.h"
+#include "sendfilesjob.h"
+#include "filequeue.h"
+#include "debug_p.h"
+
+#include <KLocalizedString>
+
+#include <BluezQt/Manager>
+#include <BluezQt/Adapter>
+#include <BluezQt/Device>
+#include <BluezQt/PendingCall>
+#include <BluezQt/ObexManager>
+
+MultiSendFilesJob::MultiSendFilesJob(FileQueue *queue, const QList<BluezQt::DevicePtr> &devices,
+                                     BluezQt::Manager *manager, BluezQt::ObexManager *obexManager,
+                                     QObject *parent)
+    : KJob(parent)
+    , m_queue(queue)
+    , m_nextTarget(0)
+    , m_activeTargets(0)
+    , m_maxConcurrent(3)
+    , m_manager(manager)
+    , m_obexManager(obexManager)
+    , m_history(nullptr)
+{
+    QStringList addresses;
+
+    Q_FOREACH (BluezQt::DevicePtr device, devices) {
+        // The same device may be known to more than one adapter
+        if (addresses.contains(device->address())) {
+            continue;
+        }
+        addresses.append(device->address());
+
+        Target target;
+        target.address = device->address();
+        target.name = device->name();
+        m_targets.append(target);
+    }
+
+    setCapabilities(Killable);
+}
+
+int MultiSendFilesJob::maximumConcurrentTransfers() const
+{
+    return m_maxConcurrent;
+}
+
+void MultiSendFilesJob::setMaximumConcurrentTransfers(int count)
+{
+    m_maxConcurrent = qMax(1, count);
+}
+
+void MultiSendFilesJob::setTransferHistory(TransferHistory *history)
+{
+    m_history = history;
+}
+
+void MultiSendFilesJob::start()
+{
+    QMetaObject::invokeMethod(this, "doStart", Qt::QueuedConnection);
+}
+
+bool MultiSendFilesJob::doKill()
+{
+    Q_FOREACH (const Target &target, m_targets) {
+        if (target.job) {
+            disconnect(target.job, nullptr, this, nullptr);
+            target.job->kill();
+        }
+        if (!target.finished && !target.session.path().isEmpty()) {
+            m_obexManager->removeSession(target.session);
+        }
+    }
+    return true;
+}
+
+void MultiSendFilesJob::doStart()
+{
+    qCDebug(SENDFILE) << "MultiSendFilesJob-DoStart" << m_targets.count() << "devices";
+
+    if (m_targets.isEmpty()) {
+        emitResult();
+        return;
+    }
+
+    connect(m_queue, &FileQueue::totalSizeChanged, this, &MultiSendFilesJob::updateTotalAmount);
+    connect(m_queue, &FileQueue::finished, this, &MultiSendFilesJob::updateDescription);
+
+    updateTotalAmount();
+    setProcessedAmount(Bytes, 0);
+    updateDescription();
+
+    startNextTargets();
+}
+
+void MultiSendFilesJob::createSessionFinished(BluezQt::PendingCall *call)
+{
+    const int index = call->userData().toInt();
+    Target &target = m_targets[index];
+
+    if (call->error()) {
+        qCWarning(SENDFILE) << "Error creating session for" << target.address << call->errorText();
+        finishTarget(index, call->errorText());
+        startNextTargets();
+        return;
+    }
+
+    target.session = call->value().value<QDBusObjectPath>();
+
+    BluezQt::AdapterPtr adapter = m_manager->adapterForAddress(target.adapter);
+    BluezQt::DevicePtr device = adapter ? adapter->deviceForAddress(target.address) : BluezQt::DevicePtr();
+    if (!device) {
+        finishTarget(index, i18n("Device has been removed"));
+        startNextTargets();
+        return;
+    }
+
+    qCDebug(SENDFILE) << "Created session for" << target.address << target.session.path();
+
+    SendFilesJob *job = new SendFilesJob(m_queue, device, target.session, this);
+    job->setTransferHistory(m_history);
+    target.job = job;
+    m_jobTargets.insert(job, index);
+
+    connect(job, &KJob::processedAmount, this, &MultiSendFilesJob::sendFilesJobProcessed);
+    connect(job, &KJob::finished, this, &MultiSendFilesJob::sendFilesJobFinished);
+    job->start();
+}
+
+void MultiSendFilesJob::sendFilesJobProcessed(KJob *job, KJob::Unit unit, qulonglong amount)
+{
+    if (unit != Bytes || !m_jobTargets.contains(job)) {
+        return;
+    }
+
+    Target &target = m_targets[m_jobTargets.value(job)];
+    target.processed = amount;
+    Q_EMIT deviceProgress(target.address, amount, m_queue->totalSize());
+
+    qulonglong processed = 0;
+    Q_FOREACH (const Target &t, m_targets) {
+        processed += t.processed;
+    }
+    setProcessedAmount(Bytes, processed);
+}
+
+void MultiSendFilesJob::sendFilesJobFinished(KJob *job)
+{
+    if (!m_jobTargets.contains(job)) {
+        return;
+    }
+
+    const int index = m_jobTargets.take(job);
+    finishTarget(index, job->error() ? job->errorText() : QString());
+    startNextTargets();
+}
+
+void MultiSendFilesJob::updateTotalAmount()
+{
+    // Failed devices only count with what was sent to them before failing
+    qulonglong total = 0;
+    Q_FOREACH (const Target &target, m_targets) {
+        total += target.errorText.isEmpty() ? m_queue->totalSize() : target.processed;
+    }
+
+    setTotalAmount(Bytes, total);
+}
+
+void MultiSendFilesJob::startNextTargets()
+{
+    while (m_activeTargets < m_maxConcurrent && m_nextTarget < m_targets.count()) {
+        const int index = m_nextTarget++;
+        Target &target = m_targets[index];
+
+        BluezQt::DevicePtr device = deviceForTarget(target);
+        if (!device) {
+            finishTarget(index, i18n("Device is not available on any powered adapter"));
+            continue;
+        }
+
+        target.adapter = device->adapter()->address();
+        m_adapterLoad[target.adapter]++;
+        m_activeTargets++;
+
+        qCDebug(SENDFILE) << "Connecting to" << target.address << "using adapter" << target.adapter;
+
+        QVariantMap args;
+        args[QStringLiteral("Target")] = QStringLiteral("opp");
+        args[QStringLiteral("Source")] = target.adapter;
+
+        BluezQt::PendingCall *call = m_obexManager->createSession(target.address, args);
+        call->setUserData(index);
+        connect(call, &BluezQt::PendingCall::finished, this, &MultiSendFilesJob::createSessionFinished);
+    }
+
+    if (m_activeTargets == 0 && m_nextTarget >= m_targets.count()) {
+        finishJob();
+    }
+}
+
+BluezQt::DevicePtr MultiSendFilesJob::deviceForTarget(const Target &target) const
+{
+    BluezQt::DevicePtr best;
+    int bestLoad = 0;
+
+    // Prefer the powered adapter with the fewest sessions currently open
+    Q_FOREACH (BluezQt::AdapterPtr adapter, m_manager->adapters()) {
+        if (!adapter->isPowered()) {
+            continue;
+        }
+
+        BluezQt::DevicePtr device = adapter->deviceForAddress(target.address);
+        if (!device) {
+            continue;
+        }
+
+        const int load = m_adapterLoad.value(adapter->address());
+        if (!best || load < bestLoad) {
+            best = device;
+            bestLoad = load;
+        }
+    }
+
+    return best;
+}
+
+void MultiSendFilesJob::finishTarget(int index, const QString &errorText)
+{
+    Target &target = m_targets[index];
+    target.finished = true;
+    target.errorText = errorText;
+    target.job = nullptr;
+
+    if (!target.adapter.isEmpty()) {
+        m_adapterLoad[target.adapter]--;
+        m_activeTargets--;
+    }
+
+    if (!target.session.path().isEmpty()) {
+        m_obexManager->removeSession(target.session);
+    }
+
+    if (errorText.isEmpty()) {
+        qCDebug(SENDFILE) << "Finished sending to" << target.address;
+        target.processed = m_queue->totalSize();
+    } else {
+        qCDebug(SENDFILE) << "Sending to" << target.address << "failed:" << errorText;
+    }
+
+    // Bytes that will never be sent to a failed device should not hold back the progress
+    updateTotalAmount();
+
+    Q_EMIT deviceFinished(target.address, errorText);
+    updateDescription();
+}
+
+void MultiSendFilesJob::updateDescription()
+{
+    int finished = 0;
+    Q_FOREACH (const Target &target, m_targets) {
+        if (target.finished) {
+            finished++;
+        }
+    }
+
+    const int count = m_queue->count();
+    const QString from = (count == 1 && m_queue->isFinished()) ? m_queue->fileName(0) : i18np("%1 file", "%1 files", count);
+
+    Q_EMIT description(this, i18n("Sending file over Bluetooth"),
+                       QPair<QString, QString>(i18nc("File transfer origin", "From"), from),
+                       QPair<QString, QString>(i18nc("File transfer destination", "To"),
+                                               i18np("%1 device", "%1 devices", m_targets.count())));
+
+    Q_EMIT infoMessage(this, i18nc("Number of devices that finished receiving the files", "%1 of %2 devices done",
+                                   finished, m_targets.count()));
+}
+
+void MultiSendFilesJob::finishJob()
+{
+    QStringList failures;
+
+    Q_FOREACH (const Target &target, m_targets) {
+        if (!target.errorText.isEmpty()) {
+            failures.append(i18nc("Device name: reason why sending the files failed", "%1: %2",
+                                  target.name, target.errorText));
+        }
+    }
+
+    if (!failures.isEmpty()) {
+        setError(UserDefinedError);
+        setErrorText(i18np("Sending files failed for %1 device:\n%2",
+                           "Sending files failed for %1 devices:\n%2",
+                           failures.count(), failures.join(QLatin1Char('\n'))));
+    }
+
+    emitResult();
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************
+ * This file is part of the KDE project                                      *
+ *                                                                           *
+ * Copyright (C) 2020 BlueDevil Developers                                   *
+ *                                                                           *
+ * This library is free software; you can redistribute it and/or             *
+ * modify it under the terms of the GNU Library General Public               *
+ * License as published by the Free Software Foundation; either              *
+ * version 2 of the License, or (at your option) any later version.          *
+ *                                                                           *
+ * This library is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU         *
+ * Library General Public License for more details.                          *
+ *                                                                           *
+ * You should have received a copy of the GNU Library General Public License *
+ * along with this library; see the file COPYING.LIB.  If not, write to      *
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,      *
+ * Boston, MA 02110-1301, USA.                                               *
+ *****************************************************************************/
+
+#ifndef MULTISENDFILESJOB_H
+#define MULTISENDFILESJOB_H
+
+#include <QHash>
+#include <QVector>
+#include <QDBusObjectPath>
+
+#include <KJob>
+
+#include <BluezQt/Types>
+
+class FileQueue;
+class TransferHistory;
+
+/**
+ * Sends the same set of files to several devices.
+ *
+ * Every target gets its own Object Push session and SendFilesJob. At most
+ * maximumConcurrentTransfers() sessions are active at the same time, and new
+ * sessions are opened on the least loaded powered adapter that knows the device.
+ * All targets share the same FileQueue, so files are scanned and prepared once.
+ */
+class MultiSendFilesJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    explicit MultiSendFilesJob(FileQueue *queue, const QList<BluezQt::DevicePtr> &devices,
+                               BluezQt::Manager *manager, BluezQt::ObexManager *obexManager,
+                               QObject *parent = nullptr);
+
+    int maximumConcurrentTransfers() const;
+    void setMaximumConcurrentTransfers(int count);
+
+    void setTransferHistory(TransferHistory *history);
+
+    void start() override;
+
+Q_SIGNALS:
+    void deviceProgress(const QString &address, qulonglong processed, qulonglong total);
+    void deviceFinished(const QString &address, const QString &errorText);
+
+protected:
+    bool doKill() override;
+
+private Q_SLOTS:
+    void doStart();
+    void createSessionFinished(BluezQt::PendingCall *call);
+    void sendFilesJobProcessed(KJob *job, KJob::Unit unit, qulonglong amount);
+    void sendFilesJobFinished(KJob *job);
+    void updateTotalAmount();
+
+private:
+    struct Target
+    {
+        QString address;
+        QString name;
+        QString adapter;
+        QDBusObjectPath session;
+        KJob *job = nullptr;
+        qulonglong processed = 0;
+        bool finished = false;
+        QString errorText;
+    };
+
+    void startNextTargets();
+    BluezQt::DevicePtr deviceForTarget(const Target &target) const;
+    void finishTarget(int index, const QString &errorText);
+    void updateDescription();
+    void finishJob();
+
+    FileQueue *m_queue;
+
+    QVector<Target> m_targets;
+    QHash<KJob*, int> m_jobTargets;
+    QHash<QString, int> m_adapterLoad;
+    int m_nextTarget;
+    int m_activeTargets;
+    int m_maxConcurrent;
+
+    BluezQt::Manager *m_manager;
+    BluezQt::ObexManager *m_obexManager;
+    TransferHistory *m_history;
+};
+
+#endif // MULTISENDFILESJOB_H
@@ -23,8 +23,11 @@
 #include "connectingpage.h"
 #include "../sendfilewizard.h"
 #include "../debug_p.h"
+#include "kdedobexopp.h"
 
 #include <QDBusObjectPath>
+#include <QDBusPendingReply>
+#include <QDBusPendingCallWatcher>
 
 #include <KLocalizedString>
 
@@ -42,16 +45,30 @@ ConnectingPage::ConnectingPage(SendFileWizard *wizard)
 void ConnectingPage::initializePage()
 {
     m_device = m_wizard->device();
-    connLabel->setText(i18nc("Connecting to a Bluetooth device", "Connecting to %1...", m_device->name()));
+
+    if (m_wizard->devices().count() > 1) {
+        connLabel->setText(i18ncp("Connecting to Bluetooth devices", "Connecting to %1 device...",
+                                  "Connecting to %1 devices...", m_wizard->devices().count()));
+    } else {
+        connLabel->setText(i18nc("Connecting to a Bluetooth device", "Connecting to %1...", m_device->name()));
+    }
 
     m_wizard->setWindowTitle(QString());
     m_wizard->setButtonLayout(wizardButtonsLayout());
 
-    // Init BluezQt
-    BluezQt::ObexManager *manager = new BluezQt::ObexManager(this);
-    BluezQt::InitObexManagerJob *job = manager->init();
-    job->start();
-    connect(job, &BluezQt::InitObexManagerJob::result, this, &ConnectingPage::initJobResult);
+    // Sessions for multiple devices are created by the job itself
+    if (m_wizard->devices().count() > 1) {
+        initObexManager();
+        return;
+    }
+
+    // Ask kded for an Object Push session, it keeps them open for a while
+    // so that sending again to the same device doesn't need to reconnect
+    org::kde::BlueDevil::ObexOpp kded(QStringLiteral("org.kde.kded5"), QStringLiteral("/modules/bluedevil"),
+                                      QDBusConnection::sessionBus());
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(kded.session(m_device->address()), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, &ConnectingPage::kdedSessionFinished);
 }
 
 bool ConnectingPage::isComplete() const
@@ -59,6 +76,29 @@ bool ConnectingPage::isComplete() const
     return false;
 }
 
+void ConnectingPage::kdedSessionFinished(QDBusPendingCallWatcher *watcher)
+{
+    const QDBusPendingReply<QString> reply = *watcher;
+    watcher->deleteLater();
+
+    if (reply.isError() || reply.value().isEmpty()) {
+        qCDebug(SENDFILE) << "No session from kded, creating our own" << reply.error().message();
+        initObexManager();
+        return;
+    }
+
+    m_wizard->startTransfer(QDBusObjectPath(reply.value()), true);
+}
+
+void ConnectingPage::initObexManager()
+{
+    // Init BluezQt
+    BluezQt::ObexManager *manager = new BluezQt::ObexManager(this);
+    BluezQt::InitObexManagerJob *job = manager->init();
+    job->start();
+    connect(job, &BluezQt::InitObexManagerJob::result, this, &ConnectingPage::initJobResult);
+}
+
 void ConnectingPage::initJobResult(BluezQt::InitObexManagerJob *job)
 {
     if (job->error()) {
@@ -67,6 +107,12 @@ void ConnectingPage::initJobResult(BluezQt::InitObexManagerJob *job)
         return;
     }
 
+    // Sessions for multiple devices are created by the job itself
+    if (m_wizard->devices().count() > 1) {
+        m_wizard->startMultiTransfer(job->manager());
+        return;
+    }
+
     // Create ObjectPush session
     QVariantMap map;
     map[QStringLiteral("Target")] = QStringLiteral("opp");
@@ -29,6 +29,8 @@
 
 #include <BluezQt/ObexManager>
 
+class QDBusPendingCallWatcher;
+
 class SendFileWizard;
 
 class ConnectingPage : public QWizardPage, public Ui::Connecting
@@ -42,10 +44,12 @@ public:
     bool isComplete() const override;
 
 private Q_SLOTS:
+    void kdedSessionFinished(QDBusPendingCallWatcher *watcher);
     void initJobResult(BluezQt::InitObexManagerJob *job);
     void createSessionFinished(BluezQt::PendingCall *call);
 
 private:
+    void initObexManager();
     QList<QWizard::WizardButton> wizardButtonsLayout() const;
 
     SendFileWizard *m_wizard;
@@ -29,6 +29,8 @@
 #include <QVBoxLayout>
 #include <QIcon>
 
+#include <KLocalizedString>
+
 #include <BluezQt/Device>
 
 SelectDevicePage::SelectDevicePage(SendFileWizard *wizard)
@@ -39,16 +41,18 @@ SelectDevicePage::SelectDevicePage(SendFileWizard *wizard)
 
     DiscoverWidget *widget = new DiscoverWidget(m_wizard->manager(), this);
     widget->setContentsMargins(0, 0, 0, 0);
+    widget->setSelectionMode(QAbstractItemView::ExtendedSelection);
     discoverLayout->addWidget(widget);
 
+    label_2->setText(i18n("Select one or more devices from the list:"));
     selectBtn->setHidden(true);
     selectLbl->setHidden(true);
-    connect(widget, &DiscoverWidget::deviceSelected, this, &SelectDevicePage::deviceSelected);
+    connect(widget, &DiscoverWidget::devicesSelected, this, &SelectDevicePage::devicesSelected);
 }
 
-void SelectDevicePage::deviceSelected(BluezQt::DevicePtr device)
+void SelectDevicePage::devicesSelected(const QList<BluezQt::DevicePtr> &devices)
 {
-    m_wizard->setDevice(device);
+    m_wizard->setDevices(devices);
 
     Q_EMIT completeChanged();
 }
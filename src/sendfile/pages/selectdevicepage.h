@@ -41,7 +41,7 @@ public:
     bool isComplete() const override;
 
 private Q_SLOTS:
-    void deviceSelected(BluezQt::DevicePtr device);
+    void devicesSelected(const QList<BluezQt::DevicePtr> &devices);
 
 private:
     SendFileWizard *m_wizard;
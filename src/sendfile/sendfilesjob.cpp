@@ -21,10 +21,13 @@
  *****************************************************************************/
 
 #include "sendfilesjob.h"
+#include "filequeue.h"
+#include "kdedobexopp.h"
+#include "../common/transferhistory.h"
 #include "debug_p.h"
+#include "../common/transfersize.h"
 
-#include <QUrl>
-#include <QFile>
+#include <QFileInfo>
 #include <QDBusObjectPath>
 
 #include <KLocalizedString>
@@ -35,27 +38,42 @@
 #include <BluezQt/ObexObjectPush>
 #include <BluezQt/InitObexManagerJob>
 
-SendFilesJob::SendFilesJob(const QStringList &files, BluezQt::DevicePtr device, const QDBusObjectPath &session, QObject *parent)
+SendFilesJob::SendFilesJob(FileQueue *queue, BluezQt::DevicePtr device, const QDBusObjectPath &session, QObject *parent)
     : KJob(parent)
-    , m_files(files)
+    , m_history(nullptr)
+    , m_queue(queue)
+    , m_currentIndex(-1)
+    , m_waitingForFile(false)
     , m_progress(0)
-    , m_totalSize(0)
     , m_speedBytes(0)
     , m_currentFileSize(0)
     , m_currentFileProgress(0)
     , m_device(device)
+    , m_kded(nullptr)
 {
-    qCDebug(SENDFILE) << "SendFilesJob:" << files;
+    setCapabilities(Killable);
+
+    m_objectPush = new BluezQt::ObexObjectPush(session, this);
+}
 
-    Q_FOREACH(const QString &filePath, files) {
-        QFile file(filePath);
-        m_filesSizes << file.size();
-        m_totalSize += file.size();
+void SendFilesJob::setSharedSession(bool shared)
+{
+    if (!shared || m_kded) {
+        return;
     }
 
-    setCapabilities(Killable);
+    m_kded = new org::kde::BlueDevil::ObexOpp(QStringLiteral("org.kde.kded5"), QStringLiteral("/modules/bluedevil"),
+                                              QDBusConnection::sessionBus(), this);
 
-    m_objectPush = new BluezQt::ObexObjectPush(session, this);
+    // Let kded close the session once it is idle
+    connect(this, &KJob::finished, this, [this]() {
+        m_kded->releaseSession(m_device->address());
+    });
+}
+
+void SendFilesJob::setTransferHistory(TransferHistory *history)
+{
+    m_history = history;
 }
 
 void SendFilesJob::start()
@@ -66,7 +84,11 @@ void SendFilesJob::start()
 bool SendFilesJob::doKill()
 {
     if (m_transfer) {
-        m_transfer->cancel();
+        if (m_kded) {
+            m_kded->cancelTransfer(m_transfer->objectPath().path());
+        } else {
+            m_transfer->cancel();
+        }
     }
     return true;
 }
@@ -75,12 +97,14 @@ void SendFilesJob::doStart()
 {
     qCDebug(SENDFILE) << "SendFilesJob-DoStart";
 
-    setTotalAmount(Bytes, m_totalSize);
-    setProcessedAmount(Bytes, 0);
+    // The queue may still be scanning, the total grows as files are found
+    connect(m_queue, &FileQueue::totalSizeChanged, this, &SendFilesJob::queueChanged);
+    connect(m_queue, &FileQueue::fileReady, this, &SendFilesJob::fileReady);
+    connect(m_queue, &FileQueue::finished, this, &SendFilesJob::queueChanged);
 
-    Q_EMIT description(this, i18n("Sending file over Bluetooth"),
-                       QPair<QString, QString>(i18nc("File transfer origin", "From"), m_files.first()),
-                       QPair<QString, QString>(i18nc("File transfer destination", "To"), m_device->name()));
+    queueChanged();
+    setProcessedAmount(Bytes, 0);
+    setProcessedAmount(Files, 0);
 
     nextJob();
 }
@@ -90,17 +114,71 @@ void SendFilesJob::nextJob()
     qCDebug(SENDFILE) << "SendFilesJob-NextJob";
 
     m_transfer.clear();
-    m_currentFile = m_files.takeFirst();
-    m_currentFileSize = m_filesSizes.takeFirst();
+    m_currentIndex++;
+
+    trySendCurrentFile();
+}
 
+void SendFilesJob::trySendCurrentFile()
+{
+    m_waitingForFile = false;
+
+    if (m_currentIndex < m_queue->count()) {
+        // The file is still being prepared, it will be sent from fileReady()
+        if (!m_queue->isReady(m_currentIndex)) {
+            qCDebug(SENDFILE) << "Waiting for" << m_queue->fileName(m_currentIndex);
+            m_waitingForFile = true;
+            return;
+        }
+
+        sendCurrentFile();
+        return;
+    }
+
+    if (!m_queue->isFinished()) {
+        m_waitingForFile = true;
+        return;
+    }
+
+    if (m_currentIndex == 0) {
+        setError(UserDefinedError);
+        setErrorText(i18n("There are no files to send"));
+    }
+
+    emitResult();
+}
+
+void SendFilesJob::sendCurrentFile()
+{
     Q_EMIT description(this, i18n("Sending file over Bluetooth"),
-                       QPair<QString, QString>(i18nc("File transfer origin", "From"), m_currentFile),
+                       QPair<QString, QString>(i18nc("File transfer origin", "From"), m_queue->fileName(m_currentIndex)),
                        QPair<QString, QString>(i18nc("File transfer destination", "To"), m_device->name()));
 
+    m_currentFile = m_queue->file(m_currentIndex);
+    m_currentFileSize = m_queue->fileSize(m_currentIndex);
+    m_fileStartTime = QDateTime::currentDateTime();
+
     BluezQt::PendingCall *call = m_objectPush->sendFile(m_currentFile);
     connect(call, &BluezQt::PendingCall::finished, this, &SendFilesJob::sendFileFinished);
 }
 
+void SendFilesJob::fileReady(int index)
+{
+    if (m_waitingForFile && index == m_currentIndex) {
+        trySendCurrentFile();
+    }
+}
+
+void SendFilesJob::queueChanged()
+{
+    setTotalAmount(Bytes, m_queue->totalSize());
+    setTotalAmount(Files, m_queue->count());
+
+    if (m_waitingForFile) {
+        trySendCurrentFile();
+    }
+}
+
 void SendFilesJob::sendFileFinished(BluezQt::PendingCall *call)
 {
     if (call->error()) {
@@ -125,12 +203,9 @@ void SendFilesJob::jobDone()
     m_currentFileSize = 0;
     m_currentFileProgress = 0;
 
-    if (!m_files.isEmpty()) {
-        nextJob();
-        return;
-    }
+    setProcessedAmount(Files, m_currentIndex + 1);
 
-    emitResult();
+    nextJob();
 }
 
 void SendFilesJob::transferredChanged(quint64 transferred)
@@ -138,12 +213,12 @@ void SendFilesJob::transferredChanged(quint64 transferred)
     // qCDebug(SENDFILE) << "SendFilesJob-Transferred" << transferred;
 
     // If at least 1 second has passed since last update
-    int secondsSinceLastTime = m_time.secsTo(QTime::currentTime());
-    if (secondsSinceLastTime > 0) {
-        float speed = (transferred - m_speedBytes) / secondsSinceLastTime;
+    const qint64 msecsSinceLastTime = m_time.elapsed();
+    if (msecsSinceLastTime >= 1000) {
+        const quint64 speed = TransferSize::speed(transferred - m_speedBytes, msecsSinceLastTime);
         emitSpeed(speed);
 
-        m_time = QTime::currentTime();
+        m_time.restart();
         m_speedBytes = transferred;
     }
 
@@ -155,11 +230,12 @@ void SendFilesJob::statusChanged(BluezQt::ObexTransfer::Status status)
     switch (status) {
     case BluezQt::ObexTransfer::Active:
         qCDebug(SENDFILE) << "SendFilesJob-Transfer Active";
-        m_time = QTime::currentTime();
+        m_time.start();
         break;
 
     case BluezQt::ObexTransfer::Complete:
         qCDebug(SENDFILE) << "SendFilesJob-Transfer Complete";
+        addToHistory(QString());
         jobDone();
         break;
 
@@ -167,6 +243,7 @@ void SendFilesJob::statusChanged(BluezQt::ObexTransfer::Status status)
         qCDebug(SENDFILE) << "SendFilesJob-Transfer Error";
         setError(UserDefinedError);
         setErrorText(i18n("Bluetooth transfer failed"));
+        addToHistory(errorText());
         emitResult();
         break;
 
@@ -183,3 +260,23 @@ void SendFilesJob::progress(quint64 transferBytes)
     m_progress += toAdd;
     setProcessedAmount(Bytes, m_progress);
 }
+
+void SendFilesJob::addToHistory(const QString &errorText)
+{
+    if (!m_history) {
+        return;
+    }
+
+    TransferHistory::Entry entry;
+    entry.direction = TransferHistory::Sent;
+    entry.address = m_device->address();
+    entry.deviceName = m_device->name();
+    entry.fileName = QFileInfo(m_queue->fileName(m_currentIndex)).fileName();
+    entry.url = QUrl::fromLocalFile(m_queue->fileName(m_currentIndex));
+    entry.size = m_currentFileSize;
+    entry.time = m_fileStartTime;
+    entry.duration = m_fileStartTime.msecsTo(QDateTime::currentDateTime());
+    entry.success = errorText.isEmpty();
+    entry.errorText = errorText;
+    m_history->add(entry);
+}
@@ -23,9 +23,8 @@
 #ifndef SENDFILESJOB_H
 #define SENDFILESJOB_H
 
-#include <QTime>
-#include <QList>
-#include <QStringList>
+#include <QElapsedTimer>
+#include <QDateTime>
 
 #include <KJob>
 
@@ -36,12 +35,22 @@ namespace BluezQt
     class ObexObjectPush;
 }
 
+class FileQueue;
+class TransferHistory;
+
+class OrgKdeBlueDevilObexOppInterface;
+
 class SendFilesJob : public KJob
 {
     Q_OBJECT
 
 public:
-    explicit SendFilesJob(const QStringList &files, BluezQt::DevicePtr device, const QDBusObjectPath &session, QObject *parent = nullptr);
+    explicit SendFilesJob(FileQueue *queue, BluezQt::DevicePtr device, const QDBusObjectPath &session, QObject *parent = nullptr);
+
+    // Session is owned by kded, which has to be asked to cancel transfers
+    void setSharedSession(bool shared);
+
+    void setTransferHistory(TransferHistory *history);
 
     void start() override;
     bool doKill() override;
@@ -49,27 +58,35 @@ public:
 private Q_SLOTS:
     void doStart();
     void nextJob();
+    void fileReady(int index);
+    void queueChanged();
     void sendFileFinished(BluezQt::PendingCall *call);
     void jobDone();
     void transferredChanged(quint64 transferred);
     void statusChanged(BluezQt::ObexTransfer::Status status);
 
 private:
+    void trySendCurrentFile();
+    void sendCurrentFile();
     void progress(quint64 transferBytes);
+    void addToHistory(const QString &errorText);
 
-    QTime m_time;
-    QStringList m_files;
-    QList <quint64> m_filesSizes;
+    QElapsedTimer m_time;
+    QDateTime m_fileStartTime;
+    TransferHistory *m_history;
+    FileQueue *m_queue;
+    int m_currentIndex;
+    bool m_waitingForFile;
     QString m_currentFile;
     quint64 m_progress;
-    quint64 m_totalSize;
-    qulonglong m_speedBytes;
+    quint64 m_speedBytes;
     quint64 m_currentFileSize;
     quint64 m_currentFileProgress;
 
     BluezQt::DevicePtr m_device;
     BluezQt::ObexTransferPtr m_transfer;
     BluezQt::ObexObjectPush *m_objectPush;
+    OrgKdeBlueDevilObexOppInterface *m_kded;
 };
 
 #endif // SENDFILESJOB_H
@@ -22,6 +22,10 @@
 
 #include "sendfilewizard.h"
 #include "sendfilesjob.h"
+#include "multisendfilesjob.h"
+#include "filequeue.h"
+#include "filetranscoder.h"
+#include "../common/transferhistory.h"
 #include "debug_p.h"
 
 #include "pages/selectdeviceandfilespage.h"
@@ -48,7 +52,11 @@ SendFileWizard::SendFileWizard(const QString &device, const QStringList &files)
     : QWizard()
     , m_deviceUrl(device)
     , m_files(files)
-    , m_job(nullptr)
+    , m_maxConcurrent(3)
+    , m_maxImageSize(0)
+    , m_imageQuality(85)
+    , m_maxFileSize(0)
+    , m_history(new TransferHistory(QStringLiteral("bluedevil-sendfile")))
 {
     setOption(NoCancelButton, false);
     setButton(QWizard::NextButton, new QPushButton(QIcon::fromTheme(QStringLiteral("document-export")), i18n("Send Files")));
@@ -72,8 +80,10 @@ SendFileWizard::SendFileWizard(const QString &device, const QStringList &files)
 SendFileWizard::~SendFileWizard()
 {
     if (m_job) {
-        m_job->doKill();
+        m_job->kill();
     }
+
+    delete m_history;
 }
 
 void SendFileWizard::done(int result)
@@ -104,35 +114,118 @@ void SendFileWizard::setFiles(const QStringList &files)
 
 BluezQt::DevicePtr SendFileWizard::device() const
 {
-    return m_device;
+    return m_devices.value(0);
 }
 
 void SendFileWizard::setDevice(BluezQt::DevicePtr device)
 {
-    m_device = device;
+    m_devices.clear();
+
+    if (device) {
+        m_devices.append(device);
+    }
+}
+
+QList<BluezQt::DevicePtr> SendFileWizard::devices() const
+{
+    return m_devices;
+}
+
+void SendFileWizard::setDevices(const QList<BluezQt::DevicePtr> &devices)
+{
+    m_devices = devices;
+}
+
+int SendFileWizard::maximumConcurrentTransfers() const
+{
+    return m_maxConcurrent;
+}
+
+void SendFileWizard::setMaximumConcurrentTransfers(int count)
+{
+    m_maxConcurrent = count;
+}
+
+void SendFileWizard::setImageScaling(int maximumSize, int quality, qint64 maximumFileSize)
+{
+    m_maxImageSize = maximumSize;
+    m_imageQuality = quality;
+    m_maxFileSize = maximumFileSize;
+}
+
+void SendFileWizard::startTransfer(const QDBusObjectPath &session, bool shared)
+{
+    if (m_files.isEmpty()) {
+        qCDebug(SENDFILE) << "No files to send";
+        return;
+    }
+
+    if (m_devices.isEmpty()) {
+        qCDebug(SENDFILE) << "No device selected";
+        return;
+    }
+
+    FileQueue *queue = createFileQueue(false);
+    SendFilesJob *job = new SendFilesJob(queue, device(), session);
+    job->setSharedSession(shared);
+    job->setTransferHistory(m_history);
+    queue->setParent(job);
+    connect(job, &SendFilesJob::destroyed, qApp, &QCoreApplication::quit);
+
+    m_job = job;
+    KIO::getJobTracker()->registerJob(job);
+    job->start();
+
+    done(1);
 }
 
-void SendFileWizard::startTransfer(const QDBusObjectPath &session)
+void SendFileWizard::startMultiTransfer(BluezQt::ObexManager *obexManager)
 {
     if (m_files.isEmpty()) {
         qCDebug(SENDFILE) << "No files to send";
         return;
     }
 
-    if (!m_device) {
+    if (m_devices.isEmpty()) {
         qCDebug(SENDFILE) << "No device selected";
         return;
     }
 
-    m_job = new SendFilesJob(m_files, m_device, session);
-    connect(m_job, &SendFilesJob::destroyed, qApp, &QCoreApplication::quit);
+    // Every device reads the same files, so let the kernel read them into
+    // the page cache once instead of hitting the disk for each device
+    FileQueue *queue = createFileQueue(true);
+    MultiSendFilesJob *job = new MultiSendFilesJob(queue, m_devices, m_manager, obexManager);
+    job->setMaximumConcurrentTransfers(m_maxConcurrent);
+    job->setTransferHistory(m_history);
+    queue->setParent(job);
+    obexManager->setParent(job);
 
-    KIO::getJobTracker()->registerJob(m_job);
-    m_job->start();
+    connect(job, &MultiSendFilesJob::destroyed, qApp, &QCoreApplication::quit);
+
+    m_job = job;
+    KIO::getJobTracker()->registerJob(job);
+    job->start();
 
     done(1);
 }
 
+FileQueue *SendFileWizard::createFileQueue(bool prefetch) const
+{
+    FileQueue *queue = new FileQueue(m_files);
+    queue->setPrefetch(prefetch);
+
+    if (m_maxImageSize > 0 || m_maxFileSize > 0) {
+        FileTranscoder *transcoder = new FileTranscoder(queue);
+        transcoder->setMaximumImageSize(m_maxImageSize);
+        transcoder->setImageQuality(m_imageQuality);
+        transcoder->setMaximumFileSize(m_maxFileSize);
+        queue->setTranscoder(transcoder);
+    }
+
+    queue->start();
+    return queue;
+}
+
 void SendFileWizard::initJobResult(BluezQt::InitManagerJob *job)
 {
     if (job->error()) {
@@ -147,18 +240,18 @@ void SendFileWizard::initJobResult(BluezQt::InitManagerJob *job)
     if (m_deviceUrl.startsWith(QLatin1String("bluetooth"))) {
         QString address = QUrl(m_deviceUrl).host();
         address.replace(QLatin1Char('-'), QLatin1Char(':'));
-        m_device = m_manager->deviceForAddress(address.toUpper());
+        setDevice(m_manager->deviceForAddress(address.toUpper()));
     } else {
-        m_device = m_manager->deviceForUbi(m_deviceUrl);
+        setDevice(m_manager->deviceForUbi(m_deviceUrl));
     }
 
     // If the device's adapter is powered off, sending file would fail.
     // Let the user know about it!
-    if (m_device && !m_device->adapter()->isPowered()) {
-        m_device.clear();
+    if (device() && !device()->adapter()->isPowered()) {
+        setDevice(BluezQt::DevicePtr());
     }
 
-    if (m_device) {
+    if (device()) {
         if (m_files.isEmpty()) {
             addPage(new SelectFilesPage(this));
         }
@@ -25,6 +25,7 @@
 
 #include <QObject>
 #include <QWizard>
+#include <QPointer>
 #include <QStringList>
 
 #include <BluezQt/Manager>
@@ -33,7 +34,10 @@
 
 class QDBusObjectPath;
 
-class SendFilesJob;
+class KJob;
+
+class FileQueue;
+class TransferHistory;
 
 class SendFileWizard : public QWizard
 {
@@ -53,18 +57,34 @@ public:
     BluezQt::DevicePtr device() const;
     void setDevice(BluezQt::DevicePtr device);
 
-    void startTransfer(const QDBusObjectPath &session);
+    QList<BluezQt::DevicePtr> devices() const;
+    void setDevices(const QList<BluezQt::DevicePtr> &devices);
+
+    int maximumConcurrentTransfers() const;
+    void setMaximumConcurrentTransfers(int count);
+
+    void setImageScaling(int maximumSize, int quality, qint64 maximumFileSize);
+
+    void startTransfer(const QDBusObjectPath &session, bool shared = false);
+    void startMultiTransfer(BluezQt::ObexManager *obexManager);
 
 private Q_SLOTS:
     void initJobResult(BluezQt::InitManagerJob *job);
 
 private:
+    FileQueue *createFileQueue(bool prefetch) const;
+
     QString m_deviceUrl;
     QStringList m_files;
 
     BluezQt::Manager *m_manager;
-    BluezQt::DevicePtr m_device;
-    SendFilesJob *m_job;
+    QList<BluezQt::DevicePtr> m_devices;
+    int m_maxConcurrent;
+    int m_maxImageSize;
+    int m_imageQuality;
+    qint64 m_maxFileSize;
+    QPointer<KJob> m_job;
+    TransferHistory *m_history;
 };
 
 #endif // SENDFILEWIZARD_H
@@ -21,6 +21,8 @@
 #include "../bluewizard.h"
 #include "../wizardagent.h"
 #include "debug_p.h"
+#include "../../common/discoveryfilter.h"
+#include "../../common/deviceschangedwatcher.h"
 
 #include <QAction>
 #include <QSortFilterProxyModel>
@@ -34,6 +36,18 @@
 #include <BluezQt/Adapter>
 #include <BluezQt/DevicesModel>
 
+// Pairing needs the device to be close, so devices that are barely in range
+// are left out. Repeated advertisements would only update RSSI values.
+static void startFilteredDiscovery(BluezQt::AdapterPtr adapter)
+{
+    QVariantMap filter;
+    filter.insert(QStringLiteral("RSSI"), QVariant::fromValue<qint16>(-90));
+    filter.insert(QStringLiteral("DuplicateData"), false);
+
+    DiscoveryFilter::apply(adapter->ubi(), filter);
+    adapter->startDiscovery();
+}
+
 class DevicesProxyModel : public QSortFilterProxyModel
 {
 public:
@@ -55,7 +69,8 @@ DevicesProxyModel::DevicesProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
     , m_devicesModel(nullptr)
 {
-    setDynamicSortFilter(true);
+    // Sorted and filtered again on batched changes from DevicesChangedWatcher
+    setDynamicSortFilter(false);
     sort(0, Qt::DescendingOrder);
 }
 
@@ -143,11 +158,15 @@ void DiscoverPage::initializePage()
     m_adapter = m_manager->usableAdapter();
     if (m_adapter && !m_adapter->isDiscovering()) {
         qCDebug(WIZARD) << "Starting scanning";
-        m_adapter->startDiscovery();
+        startFilteredDiscovery(m_adapter);
     }
 
     if (!m_model->sourceModel()) {
         m_model->setDevicesModel(new BluezQt::DevicesModel(m_manager, this));
+
+        DevicesChangedWatcher *watcher = new DevicesChangedWatcher(m_manager, this);
+        connect(watcher, &DevicesChangedWatcher::devicesChanged, m_model, &QSortFilterProxyModel::invalidate);
+        connect(m_manager, &BluezQt::Manager::adapterChanged, m_model, &QSortFilterProxyModel::invalidate);
     }
 
     deviceView->setCurrentIndex(QModelIndex());
@@ -242,7 +261,7 @@ void DiscoverPage::usableAdapterChanged(BluezQt::AdapterPtr adapter)
     m_adapter = adapter;
 
     if (m_adapter && !m_adapter->isDiscovering()) {
-        m_adapter->startDiscovery();
+        startFilteredDiscovery(m_adapter);
     }
 
     checkAdapters();